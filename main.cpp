@@ -43,17 +43,53 @@
 #include <string>
 #include <fstream>
 #include <sstream>
-#include <algorithm> // For std::sort
+#include <algorithm> // For std::sort, std::push_heap and std::pop_heap
+#include <cstdint>
+#include <cstddef> // For offsetof
+#include <type_traits>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <deque>
+#include <limits>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <sys/mman.h> // For mmap
+#include <sys/stat.h>
+#include <sys/resource.h> // For getrusage
+#include <fcntl.h>
+#include <unistd.h>
+// Vector kernels, see fillMasked
+#ifndef PLANNER_SIMD
+#define PLANNER_SIMD 1
+#endif
+#if PLANNER_SIMD && defined(__x86_64__) && defined(__GNUC__)
+#define PLANNER_AVX2 1
+#include <immintrin.h>
+#elif PLANNER_SIMD && defined(__aarch64__) && defined(__ARM_NEON)
+#define PLANNER_NEON 1
+#include <arm_neon.h>
+#endif
 using std::cout;
 using std::vector;
 using std::string;
-using std::ifstream;
 using std::istringstream;
 using std::abs;
 using std::sort;
+using std::push_heap;
+using std::pop_heap;
 
-// Custom State Type
-enum class State {
+// Custom State Type. Stored as a single byte per cell
+enum class State : uint8_t {
    kEmpty,     // To represent empty cell
    kObstacle,  // To represent cell containing obstacle
    kClosed,    // To represent processed cell
@@ -65,241 +101,5620 @@ enum class State {
 
 const int direction_delta[4][2] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
 
+// Row stride of the grid buffer is padded to a multiple of this
+const int kRowAlignment = 64;
+
+/*
+ * Optional bit-packed occupancy layer of a grid, 64 cells per word.
+ * Bit i + 64 is set when cell i of the grid buffer is an obstacle.
+ * The leading word and the trailing words are all set, so that
+ * 64-bit windows just off the grid buffer read as obstacles.
+ * Since the grid stride is a multiple of 64 every row starts at
+ * a word boundary and cell indices map straight to bit indices.
+ */
+struct OccupancyBitmap {
+   vector<uint64_t> words;
+};
+
+/*
+ * Labels of the connected components of the free cells of a grid,
+ * so that a query between two components is rejected without a
+ * search. Cells are connected through their four neighbours, which
+ * also covers diagonal moves since those may not cut corners.
+ *   labels     : component of every cell, -1 for obstacles
+ *   sizes      : number of cells of every component label
+ *   freeLabels : labels of components that have vanished, for reuse
+ */
+struct Components {
+   vector<int32_t> labels;
+   vector<int32_t> sizes;
+   vector<int32_t> freeLabels;
+};
+
+/*
+ * Abstract graph of a grid for hierarchical path finding (HPA*).
+ * The board is split into square clusters of clusterSize cells.
+ * Every gap in the border between two neighbouring clusters gets
+ * entrance nodes, one on each side, linked to each other across the
+ * border. Within a cluster every entrance node is linked to the other
+ * entrance nodes it can reach, at their shortest distance inside the
+ * cluster. Edges are stored in compressed rows: the edges of node n
+ * are edges[edgeStart[n]] up to edges[edgeStart[n + 1]], and the
+ * entrance nodes of cluster c are listed the same way through
+ * clusterStart and clusterNodes.
+ */
+struct HierarchyEdge {
+   int32_t to;
+   int32_t cost;
+};
+
+struct Hierarchy {
+   int clusterSize = 0;
+   int clusterRows = 0;
+   int clusterColumns = 0;
+   vector<int32_t> nodeCells;     // Grid cell of every entrance node
+   vector<uint32_t> edgeStart;
+   vector<HierarchyEdge> edges;
+   vector<uint32_t> clusterStart;
+   vector<int32_t> clusterNodes;
+};
+
+/*
+ * Storage of a per cell layer of a grid. The values either live
+ * in a heap allocated vector or are part of a memory-mapped grid
+ * file, in which case owner keeps the mapping alive.
+ * Copying a buffer always makes an owned copy of the values, so
+ * a copied grid can be modified without touching the original.
+ */
+template <typename T>
+struct LayerBuffer {
+   T * cells = nullptr;
+   size_t count = 0;
+   std::shared_ptr<T> owner;
+
+   LayerBuffer() = default;
+   LayerBuffer(size_t count, T value) { adopt(vector<T>(count, value)); }
+   LayerBuffer(std::shared_ptr<T> mapping, size_t count)
+      : cells(mapping.get()), count(count), owner(std::move(mapping)) {}
+   LayerBuffer(const LayerBuffer & other) { adopt(vector<T>(other.begin(), other.end())); }
+   LayerBuffer(LayerBuffer && other) noexcept
+      : cells(other.cells), count(other.count), owner(std::move(other.owner)) {
+      other.cells = nullptr; other.count = 0;
+   }
+   LayerBuffer & operator=(LayerBuffer other) noexcept {
+      std::swap(cells, other.cells); std::swap(count, other.count); owner.swap(other.owner);
+      return *this;
+   }
+
+   // Takes over the given vector without copying it
+   void adopt(vector<T> && heap) {
+      auto storage = std::make_shared<vector<T>>(std::move(heap));
+      cells = storage->data(); count = storage->size();
+      owner = std::shared_ptr<T>(storage, cells);
+   }
+
+   T & operator[](size_t i) { return cells[i]; }
+   const T & operator[](size_t i) const { return cells[i]; }
+   size_t size() const { return count; }
+   bool empty() const { return count == 0; }
+   T * begin() { return cells; }
+   T * end() { return cells + count; }
+   const T * begin() const { return cells; }
+   const T * end() const { return cells + count; }
+};
+
+using CellBuffer = LayerBuffer<State>;
+using CostBuffer = LayerBuffer<uint8_t>;
+
+/*
+ * Terrain cost of a cell, the cost of moving onto it. Board cells
+ * cost kMinCost up to kMaxCost, obstacles and sentinels kImpassable.
+ */
+const uint8_t kMinCost = 1;
+const uint8_t kMaxCost = 254;
+const uint8_t kImpassable = 255;
+
+/*
+ * Landmark distance tables for the ALT heuristic. For each landmark
+ * the number of four-connected steps from it to every cell of the
+ * grid, built by buildLandmarks or mapped from a file by
+ * mapLandmarks. They take count * 2 bytes per cell of the grid buffer.
+ *   count     : number of landmarks, 0 when no tables are built
+ *   cells     : grid cell of every landmark
+ *   distances : count values per cell, the values of all landmarks for
+ *               one cell next to each other so that the heuristic
+ *               reads them from a single cache line. kLandmarkFar
+ *               marks cells that cannot be reached from a landmark or
+ *               lie further away than the table can hold.
+ */
+const uint16_t kLandmarkFar = 0xFFFF;
+
+struct Landmarks {
+   int count = 0;
+   vector<int32_t> cells;
+   LayerBuffer<uint16_t> distances;
+};
+
+/*
+ * Tiled copy of the terrain costs for cache friendly searches. The
+ * bordered board is cut into square tiles of kTileSide cells, each
+ * tile stored as one contiguous row-major block and the tiles in
+ * row-major order. A move in any direction stays inside the block
+ * of the current tile unless it crosses a tile edge, so a search
+ * front mostly touches a few resident tiles instead of one cache
+ * line per row. With 8x8 tiles a tile of scratch entries takes
+ * 1 KiB. Cells are addressed with tiledIndex.
+ *   tileColumns : number of tiles per row of tiles
+ *   costs       : terrain cost of every cell in tiled order, board
+ *                 cells kMinCost up to kMaxCost and all others
+ *                 kImpassable
+ */
+const int kTileBits = 3;
+const int kTileSide = 1 << kTileBits;
+const int kTileMask = kTileSide - 1;
+const int kTileCells = kTileSide * kTileSide;
+
+struct TileLayer {
+   int tileColumns = 0;
+   vector<uint8_t> costs;
+};
+
+/*
+ * Grid board stored as one contiguous row-major buffer of cells.
+ * The board is surrounded by a border of kObstacle sentinel cells
+ * so that neighbours can be visited by plain index arithmetic
+ * without checking whether the position is on the grid.
+ *   rows, columns : dimensions of the board
+ *   stride        : number of stored cells per row (columns + 2 sentinels
+ *                   padded with obstacles to a multiple of kRowAlignment)
+ *   cells         : (rows + 2) * stride cells including the border
+ *   occupancy     : bit-packed copy of the obstacles, empty until
+ *                   built by buildOccupancy
+ *   hierarchy     : abstract graph for hierarchical searches, empty
+ *                   until built by buildHierarchy or readHierarchy
+ *   costs         : terrain cost of every cell laid out like cells,
+ *                   empty when every board cell costs kMinCost
+ *   minCost       : lowest terrain cost of the board, scales the
+ *                   heuristics so that they stay admissible
+ *   components    : connected component labels, empty until built
+ *                   by buildComponents
+ *   landmarks     : distance tables for the ALT heuristic, empty until
+ *                   built by buildLandmarks or mapped by mapLandmarks
+ *   tiles         : tiled copy of the costs, empty until built by
+ *                   buildTiles
+ *   version       : bumped by setCellState on every change of a cell,
+ *                   so that results planned on older cells are known
+ */
+struct Grid {
+   int rows = 0;
+   int columns = 0;
+   int stride = 0;
+   CellBuffer cells;
+   OccupancyBitmap occupancy;
+   Hierarchy hierarchy;
+   CostBuffer costs;
+   int minCost = kMinCost;
+   Components components;
+   Landmarks landmarks;
+   TileLayer tiles;
+   uint64_t version = 0;
+};
+
+/*
+ * Returns the row stride of the grid buffer for a board
+ * with the given number of columns
+ */
+int gridStride(int columns) {
+   return (columns + 2 + kRowAlignment - 1) / kRowAlignment * kRowAlignment;
+}
+
+/*
+ * Returns a grid of given dimensions with all board
+ * cells empty and the sentinel border in place
+ */
+Grid makeGrid(int rows, int columns) {
+   Grid grid;
+   grid.rows = rows;
+   grid.columns = columns;
+   grid.stride = gridStride(columns);
+   grid.cells = CellBuffer((rows + 2) * grid.stride, State::kObstacle);
+   for (int x = 0; x < rows; x++) {
+      State * row = &grid.cells[(x + 1) * grid.stride + 1];
+      std::fill(row, row + columns, State::kEmpty);
+   }
+   return grid;
+}
+
+/*
+ * Helper functions to convert x and y position values
+ * into a cell index of the grid buffer and back again
+ */
+int cellIndex(const Grid & grid, int x, int y) {
+   return (x + 1) * grid.stride + (y + 1);
+}
+
+int cellX(const Grid & grid, int cell) { return cell / grid.stride - 1; }
+int cellY(const Grid & grid, int cell) { return cell % grid.stride - 1; }
+
+/*
+ * Same as above for the tiled layer of the grid. The sentinel
+ * border is part of the tiles just like in the grid buffer.
+ */
+int tiledIndex(const Grid & grid, int x, int y) {
+   int tx = (x + 1) >> kTileBits; int ty = (y + 1) >> kTileBits;
+   int tile = tx * grid.tiles.tileColumns + ty;
+   return tile * kTileCells + (((x + 1) & kTileMask) << kTileBits) + ((y + 1) & kTileMask);
+}
+
+int tiledX(const Grid & grid, int cell) {
+   int tile = cell / kTileCells;
+   return (tile / grid.tiles.tileColumns) * kTileSide + ((cell >> kTileBits) & kTileMask) - 1;
+}
+
+int tiledY(const Grid & grid, int cell) {
+   int tile = cell / kTileCells;
+   return (tile % grid.tiles.tileColumns) * kTileSide + (cell & kTileMask) - 1;
+}
+
+/*
+ * Returns the tiled index of the neighbour of the given tiled cell
+ * in the given direction of direction_delta. Moves inside a tile are
+ * a fixed offset, moves across a tile edge land on the opposite edge
+ * of the next tile.
+ */
+int tiledNeighbour(const Grid & grid, int cell, int direction) {
+   int rowStep = grid.tiles.tileColumns * kTileCells;
+   int edge = (kTileSide - 1) * kTileSide;
+   switch (direction) {
+      case 0: return ((cell >> kTileBits) & kTileMask) ? cell - kTileSide : cell - rowStep + edge;
+      case 1: return (cell & kTileMask) ? cell - 1 : cell - kTileCells + kTileMask;
+      case 2: return ((cell >> kTileBits) & kTileMask) != kTileMask ? cell + kTileSide
+                                                                   : cell + rowStep - edge;
+      default: return (cell & kTileMask) != kTileMask ? cell + 1 : cell + kTileCells - kTileMask;
+   }
+}
+
+/*
+ * Builds the bit-packed occupancy layer of the given grid.
+ * Must be called again whenever obstacles of the grid change.
+ */
+void buildOccupancy(Grid & grid) {
+   OccupancyBitmap & occupancy = grid.occupancy;
+   occupancy.words.assign(grid.cells.size() / 64 + 3, ~uint64_t{0});
+   for (size_t cell = 0; cell < grid.cells.size(); cell++) {
+      if (grid.cells[cell] != State::kObstacle) {
+         size_t bit = cell + 64;
+         occupancy.words[bit >> 6] &= ~(uint64_t{1} << (bit & 63));
+      }
+   }
+}
+
+/*
+ * Builds the tiled layer of the given grid from its cells and costs.
+ * Changes through setCellState keep it up to date.
+ */
+void buildTiles(Grid & grid) {
+   TileLayer & tiles = grid.tiles;
+   int tileRows = (grid.rows + 2 + kTileMask) >> kTileBits;
+   tiles.tileColumns = (grid.columns + 2 + kTileMask) >> kTileBits;
+   tiles.costs.assign(size_t(tileRows) * tiles.tileColumns * kTileCells, kImpassable);
+   for (int x = 0; x < grid.rows; x++) {
+      for (int y = 0; y < grid.columns; y++) {
+         int cell = cellIndex(grid, x, y);
+         uint8_t cost = grid.costs.empty() ? kMinCost : grid.costs[cell];
+         tiles.costs[tiledIndex(grid, x, y)] =
+            (grid.cells[cell] == State::kObstacle) ? kImpassable : cost;
+      }
+   }
+}
+
+/*
+ * Returns a fingerprint of the obstacles of the given grid, so that
+ * files of precomputed data can tell whether they were built for the
+ * same map and not just for one of the same size. Packs the cells
+ * into one bit each and mixes them 64 at a time.
+ */
+uint64_t gridFingerprint(const Grid & grid) {
+   uint64_t hash = 0x9E3779B97F4A7C15ull ^ (uint64_t(grid.rows) << 32 | uint32_t(grid.columns));
+   auto mix = [&](uint64_t word) {
+      hash ^= word + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+      hash *= 0xFF51AFD7ED558CCDull;
+   };
+   uint64_t word = 0;
+   for (size_t cell = 0; cell < grid.cells.size(); cell++) {
+      if (grid.cells[cell] == State::kObstacle) { word |= uint64_t{1} << (cell & 63); }
+      if ((cell & 63) == 63) { mix(word); word = 0; }
+   }
+   mix(word);
+   return hash ^ (hash >> 29);
+}
+
+/*
+ * Returns the occupancy bits of the 64 cells starting at the given
+ * cell index in bit 0 to 63. The cell may lie up to 64 cells before
+ * the start or after the end of the grid buffer.
+ */
+uint64_t occupancyWindow(const OccupancyBitmap & occupancy, int cell) {
+   unsigned bit = cell + 64;
+   unsigned word = bit >> 6; unsigned shift = bit & 63;
+   uint64_t window = occupancy.words[word] >> shift;
+   if (shift != 0) { window |= occupancy.words[word + 1] << (64 - shift); }
+   return window;
+}
+
+/*
+ * Position of the lowest and the highest set bit counted from
+ * bit 0 and bit 63 respectively. Both return 64 for an empty word.
+ */
+int lowestBit(uint64_t word) { return word ? __builtin_ctzll(word) : 64; }
+int highestBit(uint64_t word) { return word ? __builtin_clzll(word) : 64; }
+
+/*
+ * Fills the given array with the index offsets of the four
+ * neighbours of a cell in the same order as direction_delta
+ */
+void neighbourOffsets(const Grid & grid, int offsets[4]) {
+   for (int i=0; i<4; i++) {
+      offsets[i] = direction_delta[i][0] * grid.stride + direction_delta[i][1];
+   }
+}
+
+/*
+ * Helper function that hands out an unused component label
+ */
+int32_t newComponent(Components & components) {
+   if (!components.freeLabels.empty()) {
+      int32_t label = components.freeLabels.back();
+      components.freeLabels.pop_back();
+      return label;
+   }
+   components.sizes.push_back(0);
+   return components.sizes.size() - 1;
+}
+
+/*
+ * Helper function that gives every cell of the component of the
+ * given cell the label to. Returns the number of cells relabelled.
+ */
+int relabelComponent(Grid & grid, int cell, int32_t to, vector<int32_t> & queue) {
+   vector<int32_t> & labels = grid.components.labels;
+   int offsets[4];
+   neighbourOffsets(grid, offsets);
+   int32_t from = labels[cell];
+   queue.assign(1, cell);
+   labels[cell] = to;
+   for (size_t head = 0; head < queue.size(); head++) {
+      for (int d=0; d<4; d++) {
+         int next = queue[head] + offsets[d];
+         if (labels[next] == from) {
+            labels[next] = to;
+            queue.push_back(next);
+         }
+      }
+   }
+   return queue.size();
+}
+
+/*
+ * Labels the connected components of the free cells of the given
+ * grid. setCellState keeps the labels up to date from then on.
+ */
+void buildComponents(Grid & grid) {
+   Components & components = grid.components;
+   components.labels.assign(grid.cells.size(), -1);
+   components.sizes.clear();
+   components.freeLabels.clear();
+   for (size_t cell = 0; cell < grid.cells.size(); cell++) {
+      if (grid.cells[cell] != State::kObstacle) { components.labels[cell] = -2; }
+   }
+   vector<int32_t> queue;
+   for (size_t cell = 0; cell < grid.cells.size(); cell++) {
+      if (components.labels[cell] != -2) { continue; }
+      int32_t label = newComponent(components);
+      components.sizes[label] = relabelComponent(grid, cell, label, queue);
+   }
+}
+
+/*
+ * Updates the component labels for a board cell that was freed.
+ * The components around it merge into the largest of them and
+ * only the smaller ones are relabelled.
+ */
+void freeComponentCell(Grid & grid, int cell) {
+   Components & components = grid.components;
+   int offsets[4];
+   neighbourOffsets(grid, offsets);
+   int32_t target = -1;
+   for (int d=0; d<4; d++) {
+      int32_t label = components.labels[cell + offsets[d]];
+      if (label >= 0 && (target < 0 || components.sizes[label] > components.sizes[target])) {
+         target = label;
+      }
+   }
+   if (target < 0) { target = newComponent(components); }
+   components.labels[cell] = target;
+   components.sizes[target]++;
+   vector<int32_t> queue;
+   for (int d=0; d<4; d++) {
+      int next = cell + offsets[d];
+      int32_t label = components.labels[next];
+      if (label < 0 || label == target) { continue; }
+      components.sizes[target] += relabelComponent(grid, next, target, queue);
+      components.sizes[label] = 0;
+      components.freeLabels.push_back(label);
+   }
+}
+
+/*
+ * Updates the component labels for a board cell that became an
+ * obstacle, which may split its component. A flood fill is grown
+ * from every free neighbour in lockstep, each marking its cells with
+ * a label of its own. Fills that meet are joined, and a set of fills
+ * that runs out of cells has found a separate component, which keeps
+ * its label. Once a single set of fills is left it is the remainder
+ * of the old component and gets its label back, so the work is
+ * bounded by the smaller parts rather than the whole component.
+ */
+void blockComponentCell(Grid & grid, int cell) {
+   Components & components = grid.components;
+   int offsets[4];
+   neighbourOffsets(grid, offsets);
+   int32_t old = components.labels[cell];
+   components.labels[cell] = -1;
+   components.sizes[old]--;
+
+   struct Fill {
+      vector<int32_t> cells;  // Cells reached, the queue of the fill
+      size_t head = 0;
+      int32_t label = 0;
+      int group = 0;          // Fill that represents the set of joined fills
+      bool done = false;      // Set of fills ran out, or is the remainder
+   };
+   Fill fills[4];
+   int count = 0;
+   for (int d=0; d<4; d++) {
+      int next = cell + offsets[d];
+      if (components.labels[next] != old) { continue; }
+      Fill & fill = fills[count];
+      fill.label = newComponent(components);
+      fill.group = count++;
+      fill.cells.push_back(next);
+      components.labels[next] = fill.label;
+   }
+   if (count == 0) {
+      components.freeLabels.push_back(old);   // The cell was a component of its own
+      return;
+   }
+   // The first fill stands for every label it was joined with
+   auto groupOf = [&](int f) {
+      while (fills[f].group != f) { f = fills[f].group; }
+      return f;
+   };
+   auto fillOf = [&](int32_t label) {
+      for (int f=0; f<count; f++) { if (fills[f].label == label) { return f; } }
+      return -1;
+   };
+   auto liveGroups = [&]() {
+      int live = 0;
+      for (int f=0; f<count; f++) { live += (groupOf(f) == f && !fills[f].done); }
+      return live;
+   };
+
+   while (liveGroups() > 1) {
+      for (int f=0; f<count; f++) {
+         Fill & fill = fills[f];
+         if (fills[groupOf(f)].done || fill.head == fill.cells.size()) { continue; }
+         int current = fill.cells[fill.head++];
+         for (int d=0; d<4; d++) {
+            int next = current + offsets[d];
+            int32_t label = components.labels[next];
+            if (label == old) {
+               components.labels[next] = fill.label;
+               fill.cells.push_back(next);
+            } else if (label >= 0 && label != fill.label) {
+               int other = fillOf(label);
+               if (other >= 0 && groupOf(other) != groupOf(f)) {
+                  fills[groupOf(other)].group = groupOf(f);
+               }
+            }
+         }
+      }
+      // Close the sets of fills that ran out of cells
+      for (int g=0; g<count; g++) {
+         if (groupOf(g) != g || fills[g].done) { continue; }
+         bool exhausted = true;
+         for (int f=0; f<count; f++) {
+            if (groupOf(f) == g && fills[f].head < fills[f].cells.size()) { exhausted = false; }
+         }
+         if (exhausted && liveGroups() > 1) { fills[g].done = true; }
+      }
+   }
+
+   // Each closed set becomes a component under the label of its first
+   // fill. The remaining set returns to the old label.
+   for (int f=0; f<count; f++) {
+      int g = groupOf(f);
+      bool remainder = !fills[g].done;
+      int32_t label = remainder ? old : fills[g].label;
+      for (int32_t c : fills[f].cells) { components.labels[c] = label; }
+      if (!remainder) {
+         components.sizes[label] += fills[f].cells.size();
+         components.sizes[old] -= fills[f].cells.size();
+      }
+      if (f != g || remainder) {
+         components.sizes[fills[f].label] = 0;
+         components.freeLabels.push_back(fills[f].label);
+      }
+   }
+}
+
+/*
+ * Returns true if the given board cells may be connected, which is
+ * always the case when the component labels are not built
+ */
+bool sameComponent(const Grid & grid, int cell, int other) {
+   const vector<int32_t> & labels = grid.components.labels;
+   return labels.empty() || labels[cell] == labels[other];
+}
+
+/*
+ * Changes the State of the given board cell and keeps the
+ * occupancy layer of the grid in step with it, if it is built.
+ * With a cost layer an obstacle gets cost kImpassable and a cell
+ * that is cleared of an obstacle gets cost kMinCost, which also
+ * becomes the lowest cost of the board. Component labels are
+ * updated as well, if they are built, and the version of the grid
+ * is bumped. Freeing a cell can shorten distances, so it drops the
+ * landmark tables of the grid.
+ * The hierarchy of the grid is not updated and has to be rebuilt
+ * once a batch of obstacle changes is complete.
+ */
+void setCellState(Grid & grid, int cell, State state) {
+   bool wasBlocked = (grid.cells[cell] == State::kObstacle);
+   bool blocked = (state == State::kObstacle);
+   grid.cells[cell] = state;
+   grid.version++;
+   if (wasBlocked && !blocked && grid.landmarks.count > 0) { grid.landmarks = Landmarks{}; }
+   if (!grid.components.labels.empty() && blocked != wasBlocked) {
+      if (blocked) {
+         blockComponentCell(grid, cell);
+      } else {
+         freeComponentCell(grid, cell);
+      }
+   }
+   if (!grid.costs.empty()) {
+      if (state == State::kObstacle) {
+         grid.costs[cell] = kImpassable;
+      } else if (grid.costs[cell] == kImpassable) {
+         grid.costs[cell] = kMinCost;
+         grid.minCost = kMinCost;
+      }
+   }
+   if (!grid.tiles.costs.empty()) {
+      uint8_t cost = grid.costs.empty() ? kMinCost : grid.costs[cell];
+      grid.tiles.costs[tiledIndex(grid, cellX(grid, cell), cellY(grid, cell))] =
+         blocked ? kImpassable : cost;
+   }
+   if (!grid.occupancy.words.empty()) {
+      size_t bit = cell + 64;
+      uint64_t mask = uint64_t{1} << (bit & 63);
+      if (state == State::kObstacle) {
+         grid.occupancy.words[bit >> 6] |= mask;
+      } else {
+         grid.occupancy.words[bit >> 6] &= ~mask;
+      }
+   }
+}
+
+/*
+ * Search node. Kept as a small trivially copyable struct so that
+ * nodes flow through the open list without any heap allocation.
+ *   cell : index of the node position in the grid buffer
+ *   g    : cost/steps it took to reach the node from the starting node
+ *   f    : g + h, where h is the heuristic value of the node
+ */
+struct Node {
+   int32_t cell;
+   int32_t g;
+   int32_t f;
+};
+static_assert(std::is_trivially_copyable<Node>::value,
+              "Node must stay trivially copyable");
+
+/*
+ * Returns the terrain cost of a cell for the given value of a grid
+ * file. 0 represents empty space of cost kMinCost and 1 an obstacle,
+ * as in plain obstacle maps. Values 2 up to kMaxCost are free cells
+ * of that cost and kImpassable and above are obstacles too.
+ */
+uint8_t cellCost(uint32_t value) {
+   if (value == 0) { return kMinCost; }
+   if (value == 1 || value >= kImpassable) { return kImpassable; }
+   return value;
+}
+
+/*
+ * Sets the cost layer of the given grid from the terrain costs of
+ * its cells and works out the lowest cost of its board. The layer
+ * is dropped when every board cell has the default cost.
+ */
+void adoptCosts(Grid & grid, vector<uint8_t> && costs) {
+   int minCost = kImpassable;
+   bool weighted = false;
+   for (uint8_t cost : costs) {
+      if (cost == kImpassable) { continue; }
+      minCost = std::min<int>(minCost, cost);
+      weighted = weighted || cost != kMinCost;
+   }
+   grid.minCost = (minCost == kImpassable) ? kMinCost : minCost;
+   grid.costs = CostBuffer();
+   if (weighted) { grid.costs.adopt(std::move(costs)); }
+}
+
+/*
+ * Streaming scanner for comma separated grid files.
+ * Reads the file in large chunks with a hand-rolled scanner and
+ * appends every row straight to the given buffers as its left
+ * sentinel followed by its cells, with the State of every cell in
+ * cells and its terrain cost in costs. When a row is complete endRow is
+ * called with its number of cells and may append the right sentinel
+ * and padding, check the width or flush the buffers to keep memory
+ * use flat however large the file is.
+ * Each row is a list of non-negative integers each followed by a
+ * comma (optional after the last value); blanks around values are
+ * skipped. Returns false if a row is empty or malformed, or if
+ * endRow returns false.
+ */
+template <typename RowHandler>
+bool scanGridFile(std::FILE * file, vector<State> & cells, vector<uint8_t> & costs,
+                  RowHandler endRow) {
+   const size_t kChunkSize = 1 << 20;
+   vector<char> chunk(kChunkSize);
+   bool lineStarted = false;   // Left sentinel of the current row is in place
+   bool pending = false;       // A value was read that has no cell yet
+   bool inNumber = false;      // The last character was a digit
+   uint32_t value = 0;
+   size_t rowStart = 0;
+
+   auto pushCell = [&](uint8_t cost) {
+      cells.push_back((cost == kImpassable) ? State::kObstacle : State::kEmpty);
+      costs.push_back(cost);
+   };
+   auto endLine = [&]() {
+      if (!lineStarted) { return false; }  // Empty line
+      if (pending) { pushCell(cellCost(value)); }
+      int width = cells.size() - rowStart;
+      lineStarted = pending = inNumber = false;
+      value = 0;
+      return width > 0 && endRow(width);
+   };
+
+   size_t length;
+   while ((length = std::fread(chunk.data(), 1, kChunkSize, file)) > 0) {
+      for (size_t i = 0; i < length; i++) {
+         char c = chunk[i];
+         if (c == '\n') {
+            if (!endLine()) { return false; }
+            continue;
+         }
+         if (!lineStarted) {
+            pushCell(kImpassable);
+            rowStart = cells.size();
+            lineStarted = true;
+         }
+         if (c >= '0' && c <= '9') {
+            if (pending && !inNumber) { return false; }  // Two values without a comma
+            value = std::min<uint32_t>(value * 10 + (c - '0'), 1000);
+            pending = inNumber = true;
+         } else if (c == ',') {
+            if (!pending) { return false; }  // Comma without a value
+            pushCell(cellCost(value));
+            value = 0;
+            pending = inNumber = false;
+         } else if (c == ' ' || c == '\t' || c == '\r') {
+            inNumber = false;
+         } else {
+            return false;
+         }
+      }
+   }
+   // Last row may not end with a newline
+   return !lineStarted || endLine();
+}
+
+/*
+ * Reads the file denoted by input path and
+ * returns a grid object containing State cells.
+ * All rows must have the same width to fit the flat
+ * grid buffer. An empty grid is returned otherwise.
+ */
+Grid readGridFile(const string path) {
+   Grid grid{};
+   std::FILE * file = std::fopen(path.c_str(), "rb");
+   if (file == nullptr) { return grid; }
+
+   // Every cell takes at least two bytes of the file
+   vector<State> cells;
+   vector<uint8_t> costs;
+   struct stat info;
+   if (fstat(fileno(file), &info) == 0) {
+      cells.reserve(info.st_size / 2);
+      costs.reserve(info.st_size / 2);
+   }
+
+   bool parsed = scanGridFile(file, cells, costs, [&](int width) {
+      if (grid.rows == 0) {
+         // First row fixes the width. Put the top sentinel row in front of it
+         grid.columns = width;
+         grid.stride = gridStride(width);
+         cells.insert(cells.begin(), grid.stride, State::kObstacle);
+         costs.insert(costs.begin(), grid.stride, kImpassable);
+      } else if (width != grid.columns) {
+         return false;
+      }
+      // Right sentinel and padding
+      cells.insert(cells.end(), grid.stride - grid.columns - 1, State::kObstacle);
+      costs.insert(costs.end(), grid.stride - grid.columns - 1, kImpassable);
+      grid.rows++;
+      return true;
+   });
+   std::fclose(file);
+
+   if (!parsed) {
+      std::cerr << "Failed to parse grid file. Invalid content!\n";
+      return Grid{};
+   }
+   if (grid.rows > 0) {
+      // Add the bottom sentinel row
+      cells.insert(cells.end(), grid.stride, State::kObstacle);
+      costs.insert(costs.end(), grid.stride, kImpassable);
+      grid.cells.adopt(std::move(cells));
+      adoptCosts(grid, std::move(costs));
+   }
+   return grid;    
+}
+
+/*
+ * Binary grid file format.
+ * A fixed size header followed by the grid buffer exactly as it is
+ * laid out in memory, sentinel border and row padding included.
+ * The file can therefore be memory-mapped and used in place
+ * without any parse step. Values are stored in native byte order.
+ * Version 2 adds an optional terrain cost layer, laid out like the
+ * cells and stored after them. Version 1 files have no cost fields
+ * in their header and are still read.
+ */
+const char kGridFileMagic[4] = {'G', 'R', 'D', 'B'};
+const uint32_t kGridFileVersion = 2;
+
+struct GridFileHeader {
+   char magic[4];
+   uint32_t version;
+   uint32_t rows;
+   uint32_t columns;
+   uint32_t stride;
+   uint32_t payloadOffset;  // Offset of the cells from the start of the file
+   uint64_t payloadSize;    // Number of cells, (rows + 2) * stride
+   uint64_t costOffset;     // Offset of the terrain costs, 0 if the grid has none
+   uint32_t minCost;        // Lowest terrain cost of the board
+   uint32_t reserved;
+};
+
+// Size of the header of version 1 files
+const size_t kGridFileHeaderV1Size = offsetof(GridFileHeader, costOffset);
+
+/*
+ * Returns the header of a binary grid file for a grid of
+ * the given dimensions without terrain costs
+ */
+GridFileHeader gridFileHeader(int rows, int columns, int stride) {
+   GridFileHeader header{};
+   std::memcpy(header.magic, kGridFileMagic, sizeof(header.magic));
+   header.version = kGridFileVersion;
+   header.rows = rows;
+   header.columns = columns;
+   header.stride = stride;
+   header.payloadOffset = sizeof(GridFileHeader);
+   header.payloadSize = uint64_t(rows + 2) * stride;
+   header.minCost = kMinCost;
+   return header;
+}
+
+/*
+ * Writes the given grid to the file denoted by path in the
+ * binary grid format. Returns false if the file could not be written.
+ */
+bool writeGridBinary(const Grid & grid, const string & path) {
+   GridFileHeader header = gridFileHeader(grid.rows, grid.columns, grid.stride);
+   if (!grid.costs.empty()) {
+      header.costOffset = header.payloadOffset + header.payloadSize;
+      header.minCost = grid.minCost;
+   }
+   std::ofstream bFile(path, std::ios::binary | std::ios::trunc);
+   bFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+   bFile.write(reinterpret_cast<const char *>(grid.cells.begin()), grid.cells.size());
+   bFile.write(reinterpret_cast<const char *>(grid.costs.begin()), grid.costs.size());
+   return static_cast<bool>(bFile);
+}
+
+/*
+ * Helper function that checks the sentinel border of the given
+ * grid. Searches rely on it instead of bounds checks, so a grid
+ * coming from a file is rejected when the border is broken.
+ */
+bool validBorder(const Grid & grid) {
+   int lastRow = (grid.rows + 1) * grid.stride;
+   for (int y = 0; y < grid.stride; y++) {
+      if (grid.cells[y] != State::kObstacle ||
+          grid.cells[lastRow + y] != State::kObstacle) { return false; }
+   }
+   for (int x = 0; x < grid.rows; x++) {
+      int rowStart = (x + 1) * grid.stride;
+      if (grid.cells[rowStart] != State::kObstacle ||
+          grid.cells[rowStart + grid.columns + 1] != State::kObstacle) { return false; }
+   }
+   return true;
+}
+
+/*
+ * Memory-maps the binary grid file denoted by path and returns a
+ * grid that uses the mapped cells in place. The mapping is private,
+ * so changes made to the grid are never written back to the file.
+ * Returns an empty grid if the file is missing or invalid.
+ */
+Grid mapGridBinary(const string & path) {
+   int fd = open(path.c_str(), O_RDONLY);
+   if (fd < 0) { return Grid{}; }
+   struct stat info;
+   if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(kGridFileHeaderV1Size)) {
+      close(fd);
+      return Grid{};
+   }
+   size_t fileSize = info.st_size;
+   void * base = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   close(fd);  // The mapping stays valid after the descriptor is closed
+   if (base == MAP_FAILED) { return Grid{}; }
+   std::shared_ptr<char> mapping(static_cast<char *>(base),
+                                 [fileSize](char * p) { munmap(p, fileSize); });
+
+   GridFileHeader header{};
+   std::memcpy(&header, base, kGridFileHeaderV1Size);
+   size_t headerSize = kGridFileHeaderV1Size;
+   if (header.version == kGridFileVersion && fileSize >= sizeof(GridFileHeader)) {
+      std::memcpy(&header, base, sizeof(header));
+      headerSize = sizeof(header);
+   } else {
+      header.minCost = kMinCost;
+   }
+   uint64_t expectedSize = uint64_t{header.rows + 2} * header.stride;
+   if (std::memcmp(header.magic, kGridFileMagic, sizeof(header.magic)) != 0 ||
+       header.version < 1 || header.version > kGridFileVersion ||
+       header.rows == 0 || header.columns == 0 ||
+       header.stride != static_cast<uint32_t>(gridStride(header.columns)) ||
+       header.payloadSize != expectedSize ||
+       header.payloadOffset < headerSize ||
+       header.payloadOffset + header.payloadSize > fileSize ||
+       (header.costOffset != 0 && (header.costOffset < headerSize ||
+                                   header.costOffset + header.payloadSize > fileSize)) ||
+       header.minCost < kMinCost || header.minCost > kMaxCost) {
+      std::cerr << "Failed to load binary grid file. Invalid header!\n";
+      return Grid{};
+   }
+
+   Grid grid{};
+   grid.rows = header.rows;
+   grid.columns = header.columns;
+   grid.stride = header.stride;
+   State * cells = reinterpret_cast<State *>(mapping.get() + header.payloadOffset);
+   grid.cells = CellBuffer(std::shared_ptr<State>(mapping, cells), header.payloadSize);
+   if (header.costOffset != 0) {
+      uint8_t * costs = reinterpret_cast<uint8_t *>(mapping.get() + header.costOffset);
+      grid.costs = CostBuffer(std::shared_ptr<uint8_t>(mapping, costs), header.payloadSize);
+      grid.minCost = header.minCost;
+   }
+   if (!validBorder(grid)) {
+      std::cerr << "Failed to load binary grid file. Invalid content!\n";
+      return Grid{};
+   }
+   return grid;
+}
+
+/*
+ * Converts the comma separated grid file denoted by input into
+ * a binary grid file. Rows are written out as soon as they are
+ * scanned, so the grid never has to fit in memory. Terrain costs
+ * are spooled to a temporary file and appended after the cells
+ * if the grid turns out to have any.
+ * Returns false if the input is invalid or the output cannot be written.
+ */
+bool convertGridFile(const string & input, const string & output) {
+   std::FILE * file = std::fopen(input.c_str(), "rb");
+   if (file == nullptr) { return false; }
+   std::ofstream bFile(output, std::ios::binary | std::ios::trunc);
+
+   // The header is written last, once the number of rows is known
+   GridFileHeader header{};
+   bFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+   std::FILE * spool = std::tmpfile();
+   if (spool == nullptr) {
+      std::fclose(file);
+      return false;
+   }
+
+   int rows = 0; int columns = 0; int stride = 0;
+   int minCost = kImpassable;
+   bool weighted = false;
+   vector<State> cells;
+   vector<uint8_t> costs;
+   bool parsed = scanGridFile(file, cells, costs, [&](int width) {
+      if (rows == 0) {
+         columns = width;
+         stride = gridStride(width);
+         vector<State> border(stride, State::kObstacle);
+         bFile.write(reinterpret_cast<const char *>(border.data()), stride);
+         vector<uint8_t> costBorder(stride, kImpassable);
+         std::fwrite(costBorder.data(), 1, stride, spool);
+      } else if (width != columns) {
+         return false;
+      }
+      for (uint8_t cost : costs) {
+         if (cost == kImpassable) { continue; }
+         minCost = std::min<int>(minCost, cost);
+         weighted = weighted || cost != kMinCost;
+      }
+      cells.insert(cells.end(), stride - columns - 1, State::kObstacle);
+      costs.insert(costs.end(), stride - columns - 1, kImpassable);
+      bFile.write(reinterpret_cast<const char *>(cells.data()), cells.size());
+      std::fwrite(costs.data(), 1, costs.size(), spool);
+      cells.clear();
+      costs.clear();
+      rows++;
+      return static_cast<bool>(bFile);
+   });
+   std::fclose(file);
+   if (!parsed || rows == 0) {
+      std::fclose(spool);
+      return false;
+   }
+
+   vector<State> border(stride, State::kObstacle);
+   bFile.write(reinterpret_cast<const char *>(border.data()), stride);
+   header = gridFileHeader(rows, columns, stride);
+   if (weighted) {
+      // Copy the spooled costs behind the cells
+      vector<uint8_t> costBorder(stride, kImpassable);
+      std::fwrite(costBorder.data(), 1, stride, spool);
+      std::rewind(spool);
+      vector<char> chunk(1 << 20);
+      size_t length;
+      while ((length = std::fread(chunk.data(), 1, chunk.size(), spool)) > 0) {
+         bFile.write(chunk.data(), length);
+      }
+      header.costOffset = header.payloadOffset + header.payloadSize;
+      header.minCost = minCost;
+   }
+   std::fclose(spool);
+   bFile.seekp(0);
+   bFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+   return static_cast<bool>(bFile);
+}
+
+/*
+ * Loads the grid file denoted by path. Files ending in .gridb
+ * are memory-mapped binary grids, anything else is parsed as
+ * a comma separated grid file.
+ */
+Grid loadGrid(const string & path) {
+   const string kBinaryExtension = ".gridb";
+   if (path.size() >= kBinaryExtension.size() &&
+       path.compare(path.size() - kBinaryExtension.size(), string::npos, kBinaryExtension) == 0) {
+      return mapGridBinary(path);
+   }
+   return readGridFile(path);
+}
+
+/*
+ * Takes State as input and returns corresponding
+ * ASCII String
+ */
+const char * cellString(State state) {
+   switch(state) {
+      case State::kObstacle: return  "⛰️   ";
+      case State::kPath: return "🚗  ";
+      case State::kStart: return "🚦  ";
+      case State::kFinish: return "🏁   ";
+      default: return "0   "; 
+   }
+}
+    
+/*
+ * Rectangle of board cells to render, from row top and column left
+ */
+struct Viewport {
+   int top = 0;
+   int left = 0;
+   int rows = 0;
+   int columns = 0;
+};
+
+/*
+ * Returns the viewport that shows the whole board of the grid
+ */
+Viewport boardViewport(const Grid & grid) {
+   return Viewport{0, 0, grid.rows, grid.columns};
+}
+
+/*
+ * Returns the smallest viewport that shows the given path with
+ * margin cells around it, clipped to the board
+ */
+Viewport pathViewport(const Grid & grid, const vector<int32_t> & path, int margin) {
+   if (path.empty()) { return boardViewport(grid); }
+   int top = grid.rows; int left = grid.columns; int bottom = 0; int right = 0;
+   for (int32_t cell : path) {
+      int x = cellX(grid, cell); int y = cellY(grid, cell);
+      top = std::min(top, x); bottom = std::max(bottom, x);
+      left = std::min(left, y); right = std::max(right, y);
+   }
+   top = std::max(0, top - margin); left = std::max(0, left - margin);
+   bottom = std::min(grid.rows - 1, bottom + margin);
+   right = std::min(grid.columns - 1, right + margin);
+   return Viewport{top, left, bottom - top + 1, right - left + 1};
+}
+
+/*
+ * Renders the cells of the grid inside the given viewport into
+ * buffer, one line per row. The cells of the given path are drawn
+ * as path, its first cell as start and its last cell as finish,
+ * without touching the grid. The buffer is sized once up front so
+ * that rendering does not allocate per cell.
+ */
+void renderBoard(const Grid & grid, const Viewport & view, const vector<int32_t> & path,
+                 string & buffer) {
+   const int kStates = static_cast<int>(State::kChosen) + 1;
+   const char * texts[kStates];
+   size_t lengths[kStates];
+   size_t widest = 0;
+   for (int i = 0; i < kStates; i++) {
+      texts[i] = cellString(static_cast<State>(i));
+      lengths[i] = std::strlen(texts[i]);
+      widest = std::max(widest, lengths[i]);
+   }
+
+   // Copy the viewport and draw the path over it
+   vector<State> cells(size_t(view.rows) * view.columns);
+   for (int x = 0; x < view.rows; x++) {
+      const State * row = &grid.cells[cellIndex(grid, view.top + x, view.left)];
+      std::copy(row, row + view.columns, cells.begin() + size_t(x) * view.columns);
+   }
+   auto draw = [&](int32_t cell, State state) {
+      int x = cellX(grid, cell) - view.top; int y = cellY(grid, cell) - view.left;
+      if (x >= 0 && x < view.rows && y >= 0 && y < view.columns) {
+         cells[size_t(x) * view.columns + y] = state;
+      }
+   };
+   for (int32_t cell : path) { draw(cell, State::kPath); }
+   if (!path.empty()) {
+      draw(path.front(), State::kStart);
+      draw(path.back(), State::kFinish);
+   }
+
+   // Size the buffer for the widest cells and trim it afterwards
+   buffer.resize(size_t(view.rows) * (view.columns * widest + 1));
+   char * out = &buffer[0];
+   const State * cell = cells.data();
+   for (int x = 0; x < view.rows; x++) {
+      for (int y = 0; y < view.columns; y++, cell++) {
+         int state = static_cast<int>(*cell);
+         std::memcpy(out, texts[state], lengths[state]);
+         out += lengths[state];
+      }
+      *out++ = '\n';
+   }
+   buffer.resize(out - buffer.data());
+}
+
+/*
+ * Prints the cells of the grid inside the given viewport onto
+ * Terminal with a single write, with the given path drawn over them
+ */
+void printBoard(const Grid & grid, const Viewport & view, const vector<int32_t> & path = {}) {
+   string buffer;
+   renderBoard(grid, view, path, buffer);
+   cout.write(buffer.data(), buffer.size());
+}
+
+void printBoard(const Grid & grid) {
+   printBoard(grid, boardViewport(grid));
+}
+
+/*
+ * To Compute Heuristic value for each node.
+ * In A* algorithm, heuristic value is the manhattan
+ * distance between given node and goal node
+ */
+int heuristic(int x1, int y1, int x2, int y2) {
+   return abs(x2 - x1) + abs(y2 - y1);
+}
+
+/*
+ * Helper function for sorting the list in 
+ * descending order. Nodes with equal f value are
+ * ordered on h so that the node closer to the goal
+ * is picked first.
+ */
+bool compare(const Node & node1, const Node & node2) {
+   if (node1.f != node2.f) { return node1.f > node2.f; }
+   return node1.g < node2.g;   // Same f, so higher g means lower h
+}
+
+/*
+ * Sort the given vector in descending order
+ * using the custom compare function
+ */
+void sortNodes(vector<Node> *v) {
+   sort(v->begin(), v->end(), compare);
+}
+
+/*
+ * Open list engines.
+ * Every engine provides the same set of helper functions
+ * (pushNode, popNode, openListEmpty, openListSize and clearOpenList) so that
+ * searchPath can be instantiated with whichever engine suits the grid.
+ * clearOpenList keeps the allocated storage for the next query.
+ */
+
+// Original engine. Sorts the whole list before every pop.
+struct SortedOpenList {
+   vector<Node> nodes;
+};
+
+// Binary min-heap on f with ties broken on lower h.
+struct BinaryHeapOpenList {
+   vector<Node> nodes;
+};
+
+/*
+ * Bucket queue indexed by f value. Works because f values are
+ * small integers on a grid with unit step costs. Every bucket
+ * is kept as a small heap on h to honour the tie breaking rule.
+ */
+struct BucketOpenList {
+   vector<vector<Node>> buckets;
+   int minF = 0;       // Lowest bucket that may hold a node
+   size_t count = 0;   // Number of nodes across all buckets
+};
+
+/*
+ * Radix heap on f. Bucket b > 0 holds the nodes whose f differs
+ * from the last popped f first in bit b - 1, so every node moves
+ * down at most 32 buckets however large the step costs are.
+ * Suits terrain costs, where f values are spread too far apart for
+ * BucketOpenList. Bucket 0 holds the nodes at the last popped f and
+ * is kept as a heap on h to honour the tie breaking rule.
+ * f must not drop below the last popped f, as holds for consistent
+ * heuristics. Nodes of an inconsistent one that do are kept in
+ * bucket 0 and still come out first.
+ */
+struct RadixHeapOpenList {
+   vector<Node> buckets[33];
+   uint32_t last = 0;   // Last popped f value
+   size_t count = 0;    // Number of nodes across all buckets
+};
+
+void pushNode(SortedOpenList & open, const Node & node) {
+   open.nodes.push_back(node);
+}
+
+Node popNode(SortedOpenList & open) {
+   sortNodes(&open.nodes); // Sorts the list in descending order
+   Node node = open.nodes.back();
+   open.nodes.pop_back();
+   return node;
+}
+
+bool openListEmpty(const SortedOpenList & open) {
+   return open.nodes.empty();
+}
+
+size_t openListSize(const SortedOpenList & open) {
+   return open.nodes.size();
+}
+
+void clearOpenList(SortedOpenList & open) {
+   open.nodes.clear();
+}
+
+void pushNode(BinaryHeapOpenList & open, const Node & node) {
+   open.nodes.push_back(node);
+   push_heap(open.nodes.begin(), open.nodes.end(), compare);
+}
+
+Node popNode(BinaryHeapOpenList & open) {
+   pop_heap(open.nodes.begin(), open.nodes.end(), compare);
+   Node node = open.nodes.back();
+   open.nodes.pop_back();
+   return node;
+}
+
+bool openListEmpty(const BinaryHeapOpenList & open) {
+   return open.nodes.empty();
+}
+
+size_t openListSize(const BinaryHeapOpenList & open) {
+   return open.nodes.size();
+}
+
+void clearOpenList(BinaryHeapOpenList & open) {
+   open.nodes.clear();
+}
+
+void pushNode(BucketOpenList & open, const Node & node) {
+   int f = node.f;
+   if (f >= static_cast<int>(open.buckets.size())) {
+      open.buckets.resize(f + 1);
+   }
+   vector<Node> & bucket = open.buckets[f];
+   bucket.push_back(node);
+   push_heap(bucket.begin(), bucket.end(), compare);
+   if (open.count == 0 || f < open.minF) { open.minF = f; }
+   open.count++;
+}
+
+Node popNode(BucketOpenList & open) {
+   // Skip the drained buckets. f never decreases with a consistent heuristic
+   while (open.buckets[open.minF].empty()) { open.minF++; }
+   vector<Node> & bucket = open.buckets[open.minF];
+   pop_heap(bucket.begin(), bucket.end(), compare);
+   Node node = bucket.back();
+   bucket.pop_back();
+   open.count--;
+   return node;
+}
+
+bool openListEmpty(const BucketOpenList & open) {
+   return open.count == 0;
+}
+
+size_t openListSize(const BucketOpenList & open) {
+   return open.count;
+}
+
+void clearOpenList(BucketOpenList & open) {
+   for (auto & bucket : open.buckets) { bucket.clear(); }
+   open.minF = 0;
+   open.count = 0;
+}
+
+/*
+ * Helper function that returns the radix heap bucket of f
+ */
+int radixBucket(uint32_t f, uint32_t last) {
+   return (f <= last) ? 0 : 64 - __builtin_clzll(f ^ last);
+}
+
+void pushNode(RadixHeapOpenList & open, const Node & node) {
+   int b = radixBucket(node.f, open.last);
+   vector<Node> & bucket = open.buckets[b];
+   bucket.push_back(node);
+   if (b == 0) { push_heap(bucket.begin(), bucket.end(), compare); }
+   open.count++;
+}
+
+Node popNode(RadixHeapOpenList & open) {
+   vector<Node> & front = open.buckets[0];
+   if (front.empty()) {
+      // Move the nodes of the first non-empty bucket down from its lowest f
+      int b = 1;
+      while (open.buckets[b].empty()) { b++; }
+      vector<Node> & bucket = open.buckets[b];
+      uint32_t last = bucket[0].f;
+      for (const Node & node : bucket) { last = std::min<uint32_t>(last, node.f); }
+      open.last = last;
+      for (const Node & node : bucket) {
+         open.buckets[radixBucket(node.f, last)].push_back(node);
+      }
+      bucket.clear();
+      std::make_heap(front.begin(), front.end(), compare);
+   }
+   pop_heap(front.begin(), front.end(), compare);
+   Node node = front.back();
+   front.pop_back();
+   open.count--;
+   return node;
+}
+
+bool openListEmpty(const RadixHeapOpenList & open) {
+   return open.count == 0;
+}
+
+size_t openListSize(const RadixHeapOpenList & open) {
+   return open.count;
+}
+
+void clearOpenList(RadixHeapOpenList & open) {
+   for (auto & bucket : open.buckets) { bucket.clear(); }
+   open.last = 0;
+   open.count = 0;
+}
+
+/*
+ * Per query search statistics. They are only collected when the
+ * program is built with -DPLANNER_STATS=1. Otherwise every counter
+ * and timer below compiles away and the fields stay at their
+ * defaults, so the search loops pay nothing for them.
+ *   expanded   : nodes taken off the open list and expanded
+ *   pushed     : nodes added to the open list
+ *   peakOpen   : largest number of entries on the open list
+ *   pathLength : cost of the path found, -1 if there is none
+ *   loadMs, searchMs, outputMs : wall clock time of the phases
+ */
+#ifndef PLANNER_STATS
+#define PLANNER_STATS 0
+#endif
+constexpr bool kCollectStats = PLANNER_STATS;
+
+struct SearchStats {
+   uint64_t expanded = 0;
+   uint64_t pushed = 0;
+   uint64_t peakOpen = 0;
+   int32_t pathLength = -1;
+   double loadMs = 0;
+   double searchMs = 0;
+   double outputMs = 0;
+};
+
+/*
+ * Helper functions that update the statistics of a query
+ */
+void countExpanded(SearchStats & stats) {
+   if constexpr (kCollectStats) { stats.expanded++; }
+}
+
+void countPushed(SearchStats & stats, size_t openSize) {
+   if constexpr (kCollectStats) {
+      stats.pushed++;
+      stats.peakOpen = std::max<uint64_t>(stats.peakOpen, openSize);
+   }
+}
+
+using StatsClock = std::chrono::steady_clock;
+
+/*
+ * Helper functions for timing a phase. statsTime returns the
+ * current time and statsElapsed the milliseconds since the given
+ * time; neither reads the clock when statistics are disabled.
+ */
+StatsClock::time_point statsTime() {
+   if constexpr (kCollectStats) { return StatsClock::now(); }
+   return StatsClock::time_point{};
+}
+
+double statsElapsed(StatsClock::time_point start) {
+   if constexpr (kCollectStats) {
+      return std::chrono::duration<double, std::milli>(StatsClock::now() - start).count();
+   }
+   return 0;
+}
+
+/*
+ * Limits of a single query run through findPath, for callers that
+ * cannot wait for a search to run its course. A search gives up as
+ * soon as it would expand more than budget nodes, the deadline has
+ * passed or *cancel is set, and marks the query as aborted. The clock
+ * and the cancel flag are only polled every kLimitPoll expansions,
+ * so that the check on every expansion is a single comparison.
+ *   budget      : largest number of expansions, 0 for no limit
+ *   hasDeadline : whether deadline applies
+ *   cancel      : flag set by another thread to give up, may be null
+ *   spent       : nodes expanded by the current query
+ *   checkAt     : value of spent at which the limits are checked next
+ *   aborted     : set when the current query gave up
+ */
+const uint64_t kLimitPoll = 1024;
+
+struct SearchLimits {
+   uint64_t budget = 0;
+   bool hasDeadline = false;
+   StatsClock::time_point deadline;
+   const std::atomic<bool> * cancel = nullptr;
+   uint64_t spent = 0;
+   uint64_t checkAt = std::numeric_limits<uint64_t>::max();
+   bool aborted = false;
+};
+
+// Moves checkAt to the next expansion at which a limit can be hit
+void scheduleLimitCheck(SearchLimits & limits) {
+   uint64_t next = std::numeric_limits<uint64_t>::max();
+   if (limits.hasDeadline || limits.cancel != nullptr) { next = limits.spent + kLimitPoll; }
+   if (limits.budget > 0) { next = std::min(next, limits.budget + 1); }
+   limits.checkAt = next;
+}
+
+// Starts the count of the limits over for a new query
+void resetLimits(SearchLimits & limits) {
+   limits.spent = 0;
+   limits.aborted = false;
+   scheduleLimitCheck(limits);
+}
+
+/*
+ * Sets the given limits to a budget of expansions and a deadline
+ * deadlineMs after the given time, 0 meaning no limit for either
+ */
+void setLimits(SearchLimits & limits, uint64_t budget, double deadlineMs,
+               StatsClock::time_point from) {
+   limits.budget = budget;
+   limits.hasDeadline = deadlineMs > 0;
+   limits.deadline = from + std::chrono::duration_cast<StatsClock::duration>(
+                               std::chrono::duration<double, std::milli>(deadlineMs));
+   resetLimits(limits);
+}
+
+/*
+ * Counts one expansion against the given limits.
+ * Returns false if the query has to give up.
+ */
+bool spendExpansion(SearchLimits & limits) {
+   if (++limits.spent < limits.checkAt) { return true; }
+   if ((limits.budget > 0 && limits.spent > limits.budget) ||
+       (limits.hasDeadline && StatsClock::now() >= limits.deadline) ||
+       (limits.cancel != nullptr && limits.cancel->load(std::memory_order_relaxed))) {
+      limits.aborted = true;
+      return false;
+   }
+   scheduleLimitCheck(limits);
+   return true;
+}
+
+// Distance of cells that cannot be reached
+const int32_t kUnreachable = 1 << 29;
+
+/*
+ * Per cell working state of a search. An entry only holds
+ * valid data while its stamp matches the generation of the
+ * SearchContext that owns it.
+ */
+struct CellScratch {
+   uint32_t seen;    // Generation in which g and parent were written
+   uint32_t closed;  // Generation in which the cell was expanded
+   int32_t g;        // Lowest cost found so far from the starting node
+   int32_t parent;   // Cell the lowest cost was reached from
+};
+
+/*
+ * Working state of hierarchicalSearch on top of the cell scratch.
+ * Abstract nodes have their own scratch entries and generation.
+ */
+struct HierarchyScratch {
+   uint32_t generation = 0;
+   vector<CellScratch> scratch;        // One entry per abstract node
+   vector<HierarchyEdge> startLinks;   // Entrances reachable from the start
+   vector<HierarchyEdge> goalLinks;    // Entrances the goal is reachable from
+   vector<int32_t> queue;              // Breadth first search queue
+   vector<int32_t> abstractPath;
+   vector<int32_t> path;
+};
+
+/*
+ * Number of open list entries per g value of one half of the
+ * bidirectional search. minDepth is a lower bound on the g value
+ * of every open node of that half.
+ */
+struct DepthCounts {
+   vector<int32_t> count;
+   int minDepth = 0;
+};
+
+/*
+ * Reusable per-query working state of searchPath.
+ * The grid itself is never written by a search, so one read-only
+ * Grid can serve any number of queries, each through its own
+ * context. Starting a query bumps the generation counter, which
+ * invalidates every scratch entry in O(1) instead of clearing them.
+ */
+template <typename OpenList = BinaryHeapOpenList>
+struct SearchContext {
+   uint32_t generation = 0;
+   vector<CellScratch> scratch;
+   OpenList open;
+   HierarchyScratch hierarchy;
+   // Backward half of bidirectionalSearch, sized on first use
+   uint32_t reverseGeneration = 0;
+   vector<CellScratch> reverseScratch;
+   OpenList reverseOpen;
+   DepthCounts depths[2];  // Forward and backward open list depths
+   // Scratch of tiledSearch in the tiled order, sized on first use
+   uint32_t tiledGeneration = 0;
+   vector<CellScratch> tiledScratch;
+   SearchStats stats;      // Statistics of the last query run through findPath
+   SearchLimits limits;    // Limits of the queries run through findPath
+};
+
+/*
+ * Moves the given generation counter to the next generation. The
+ * scratch entries stamped with it are only cleared when the counter
+ * wraps around, as stale stamps could match again after that.
+ */
+void nextGeneration(uint32_t & generation, vector<CellScratch> & scratch) {
+   generation++;
+   if (generation == 0) {
+      std::fill(scratch.begin(), scratch.end(), CellScratch{});
+      generation = 1;
+   }
+}
+
+/*
+ * Prepares the given context for a new query on the given grid.
+ * The scratch entries are only cleared when the context is first
+ * used with a grid of a different size or when the generation
+ * counter wraps around.
+ */
+template <typename OpenList>
+void beginQuery(SearchContext<OpenList> & context, const Grid & grid) {
+   if (context.scratch.size() != grid.cells.size()) {
+      context.scratch.assign(grid.cells.size(), CellScratch{});
+      context.generation = 0;
+   }
+   nextGeneration(context.generation, context.scratch);
+   clearOpenList(context.open);
+}
+
+/*
+ * Adds the given node to the list of open nodes of the context
+ * and records its cost and the cell it was reached from.
+ */
+template <typename OpenList>
+void addToOpenNodes(const Node & node, int parent,
+                    SearchContext<OpenList> & context) {
+   CellScratch & scratch = context.scratch[node.cell];
+   scratch.seen = context.generation;
+   scratch.g = node.g;
+   scratch.parent = parent;
+   pushNode(context.open, node);
+   countPushed(context.stats, openListSize(context.open));
+}
+
+/*
+ * Helper function that checks whether the given 
+ * x and y values are valid positions on given grid
+ */
+bool validPosOnGrid(int x, int y, const Grid & grid) {
+   bool x_on_grid = (x >= 0 && x < grid.rows);
+   bool y_on_grid = (y >= 0 && y < grid.columns);
+   return x_on_grid && y_on_grid;
+}
+
+/*
+ * Returns true if the given cell can be moved onto else returns false.
+ * Cells just off the board are sentinel obstacles, so a
+ * neighbour of any board cell never needs a bounds check.
+ */
+bool validOpenNodePos(int cell, const Grid & grid) {
+   return grid.cells[cell] != State::kObstacle;
+}
+
+/*
+ * Same as above but reads the bit-packed occupancy layer
+ */
+bool validOpenNodePos(int cell, const OccupancyBitmap & occupancy) {
+   unsigned bit = cell + 64;
+   return ((occupancy.words[bit >> 6] >> (bit & 63)) & 1) == 0;
+}
+
+/*
+ * Neighbourhood policies for searchPath. Each policy lists its
+ * moves as direction deltas with their integer step costs, and
+ * tells whether a move out of a cell is allowed. All members are
+ * compile-time constants so that every instantiation of the
+ * search unrolls its neighbour loop.
+ *   kCardinalCost : cost of a move along a row or a column
+ *   kDiagonalCost : cost of a diagonal move, used by the heuristics
+ *   stepCost      : cost of a move onto the given cell
+ *   costScale     : factor of the heuristic estimates of a grid
+ */
+struct FourConnected {
+   static constexpr int kMoves = 4;
+   static constexpr int kDelta[4][2] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
+   static constexpr int kCost[4] = {1, 1, 1, 1};
+   static constexpr int kCardinalCost = 1;
+   static constexpr int kDiagonalCost = 2;  // Two cardinal moves
+   static bool allowed(const Grid &, int, int) { return true; }
+   static int stepCost(const Grid &, int, int move) { return kCost[move]; }
+   static int costScale(const Grid &) { return 1; }
+};
+
+/*
+ * Eight-connected moves. The first four moves follow direction_delta
+ * and the diagonals follow. Costs are in tenths of a cell with a
+ * diagonal move costing 14, which keeps all costs integer.
+ * A diagonal move may not cut the corner of an obstacle, so both
+ * cells it passes between have to be free.
+ */
+struct EightConnected {
+   static constexpr int kMoves = 8;
+   static constexpr int kDelta[8][2] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1},
+                                        {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+   static constexpr int kCost[8] = {10, 10, 10, 10, 14, 14, 14, 14};
+   static constexpr int kCardinalCost = 10;
+   static constexpr int kDiagonalCost = 14;
+   static bool allowed(const Grid & grid, int cell, int move) {
+      if (move < 4) { return true; }
+      return validOpenNodePos(cell + kDelta[move][0] * grid.stride, grid) &&
+             validOpenNodePos(cell + kDelta[move][1], grid);
+   }
+   static int stepCost(const Grid &, int, int move) { return kCost[move]; }
+   static int costScale(const Grid &) { return 1; }
+};
+
+/*
+ * Terrain costs on top of another neighbourhood. A move costs its
+ * base cost times the terrain cost of the cell it moves onto, and
+ * the heuristics are scaled by the lowest terrain cost of the grid
+ * so that they stay admissible. Needs the cost layer of the grid.
+ */
+template <typename Base>
+struct TerrainCost : Base {
+   static int stepCost(const Grid & grid, int cell, int move) {
+      return Base::kCost[move] * grid.costs[cell];
+   }
+   static int costScale(const Grid & grid) { return grid.minCost; }
+};
+
+/*
+ * Heuristic policies for searchPath. estimate() takes the grid, the
+ * cell and the goal cell along with the absolute row and column
+ * distances between them, and returns the estimated cost in the
+ * units of the given neighbourhood.
+ */
+struct ManhattanHeuristic {
+   template <typename Neighbourhood>
+   static int estimate(const Grid &, int, int, int dx, int dy) {
+      return (dx + dy) * Neighbourhood::kCardinalCost;
+   }
+};
+
+/*
+ * Octile distance: diagonal moves as long as both distances last,
+ * then straight moves. Same as Manhattan for FourConnected.
+ */
+struct OctileHeuristic {
+   template <typename Neighbourhood>
+   static int estimate(const Grid &, int, int, int dx, int dy) {
+      int diagonal = std::min(dx, dy);
+      int straight = std::max(dx, dy) - diagonal;
+      return straight * Neighbourhood::kCardinalCost + diagonal * Neighbourhood::kDiagonalCost;
+   }
+};
+
+/*
+ * Weighted A*: scales the base heuristic by Numerator/Denominator.
+ * A weight above 1 expands fewer nodes and returns a path at most
+ * that many times longer than the optimum.
+ */
+template <typename Base, int Numerator, int Denominator = 1>
+struct WeightedHeuristic {
+   template <typename Neighbourhood>
+   static int estimate(const Grid & grid, int cell, int goalCell, int dx, int dy) {
+      return Base::template estimate<Neighbourhood>(grid, cell, goalCell, dx, dy) *
+             Numerator / Denominator;
+   }
+};
+
+/*
+ * ALT heuristic: the triangle inequality over the landmark distance
+ * tables of the grid gives |d(L, goal) - d(L, cell)| as a lower bound
+ * for every landmark L. Returns the largest of those bounds and the
+ * Manhattan distance, or just the latter when no tables are built.
+ * The tables hold four-connected steps, so it only fits four-connected
+ * neighbourhoods.
+ */
+struct LandmarkHeuristic {
+   template <typename Neighbourhood>
+   static int estimate(const Grid & grid, int cell, int goalCell, int dx, int dy) {
+      static_assert(Neighbourhood::kMoves == 4, "Landmark distances are four-connected");
+      int best = dx + dy;
+      const Landmarks & landmarks = grid.landmarks;
+      if (landmarks.count > 0) {
+         const uint16_t * from = &landmarks.distances[size_t(cell) * landmarks.count];
+         const uint16_t * to = &landmarks.distances[size_t(goalCell) * landmarks.count];
+         for (int k = 0; k < landmarks.count; k++) {
+            if (from[k] == kLandmarkFar || to[k] == kLandmarkFar) { continue; }
+            best = std::max(best, abs(int(from[k]) - int(to[k])));
+         }
+      }
+      return best * Neighbourhood::kCardinalCost;
+   }
+};
+
+/*
+ * Expand from current node to neighbouring nodes.
+ * While iterating through neighbouring nodes,
+ * if the node is open i.e. (not closed && not obstacle)
+ * and is reached at a lower cost than before
+ * then add that node to open list else skip that node
+ */
+template <typename Neighbourhood, typename Heuristic, typename OpenList>
+void expandNeighbours(const Node & currNode,
+                      const int goal[2],
+                      const Grid & grid,
+                      SearchContext<OpenList> & context) {
+   int currX = cellX(grid, currNode.cell);
+   int currY = cellY(grid, currNode.cell);
+   int goalCell = cellIndex(grid, goal[0], goal[1]);
+   int costScale = Neighbourhood::costScale(grid);
+   // Iterate through potential neighbour node positions
+   for (int i=0; i<Neighbourhood::kMoves; i++) {
+      const int (&delta)[2] = Neighbourhood::kDelta[i];
+      int cell = currNode.cell + delta[0] * grid.stride + delta[1];
+      if (!validOpenNodePos(cell, grid)) { continue; }
+      if (!Neighbourhood::allowed(grid, currNode.cell, i)) { continue; }
+      const CellScratch & scratch = context.scratch[cell];
+      if (scratch.closed == context.generation) { continue; }
+      int g = currNode.g + Neighbourhood::stepCost(grid, cell, i);
+      if (scratch.seen == context.generation && scratch.g <= g) { continue; }
+      // Valid open node position. Assign g and h values and add to open list
+      int x = currX + delta[0];
+      int y = currY + delta[1];
+      int h = Heuristic::template estimate<Neighbourhood>(grid, cell, goalCell,
+                                                          abs(goal[0] - x), abs(goal[1] - y)) *
+              costScale;
+      // Form the node and add it to open list
+      Node node{cell, g, g + h};
+      addToOpenNodes(node, currNode.cell, context);
+   }
+}
+
+/*
+ * Finds the optimum path between start and finish
+ * points in the given grid using A* search algorithm.
+ * Returns true if a path was found. The working state
+ * of the search is left in the given context.
+ * The open list engine is chosen through the context
+ * and defaults to the binary heap.
+ * The neighbourhood and heuristic policies are template
+ * parameters, so each combination compiles to its own
+ * kernel. They default to four-connected moves with
+ * Manhattan distance, where path costs are in steps.
+ * Wrap the neighbourhood in TerrainCost to search on the
+ * terrain costs of the grid.
+ */
+template <typename Neighbourhood = FourConnected, typename Heuristic = ManhattanHeuristic,
+          typename OpenList>
+bool searchPath(const Grid & grid, SearchContext<OpenList> & context,
+                const int init[2], const int goal[2]) {
+
+   /*
+    * For A* Search algorithm,
+    * There should be a list of open nodes which it will check 
+    * every iteration. Each node should contain following information
+    *   x and y position values (packed into a single cell index)
+    *   g value (Represents the cost/steps it took to reach that node from starting node)
+    *   f value (g plus the heuristic distance h between this node and finishing node)
+    * As you get closer to goal, h value decreases and g value increases.
+    * 
+    * A* search algorithm picks the node that has the least g+h value from the list of open
+    * nodes and expand from it to neighbouring nodes.
+    * The neighbouring nodes that are not yet closed(already processed), are on grid and are
+    * not obstacles will get added to open nodes list whenever they are reached at a lower
+    * cost than before. Once a node is picked from the open nodes list, it is closed.
+    * Keep picking the node with lowest f value(g+h) from the open nodes list and process it 
+    * as described above until the path to goal node is found or until there are no more nodes
+    * present in the open list.
+    */
+   beginQuery(context, grid);
+
+   /*
+    * Form the starting node to be added to list of open node
+    */
+   int x = init[0]; int y = init[1];  // Position information
+   int g = 0; // Cost
+   // Calculates the heuristic distance to goal node
+   int goalCell = cellIndex(grid, goal[0], goal[1]);
+   int startCell = cellIndex(grid, x, y);
+   int h = Heuristic::template estimate<Neighbourhood>(grid, startCell, goalCell,
+                                                       abs(goal[0] - x), abs(goal[1] - y)) *
+           Neighbourhood::costScale(grid);
+   Node startNode{startCell, g, g + h};
+
+   /*
+    * Add the node to list of open nodes
+    */
+   addToOpenNodes(startNode, -1, context);  // Add the starting node to list of open nodes
+
+   /*
+    * Keep processing the list of open nodes until the list is empty
+    * or until the goal node is reached
+    */
+   while(!openListEmpty(context.open)) {
+      /*
+       * Fetch the node with the least (g+h) value from the open nodes list
+       * as the current node to expand to neighbours
+       */
+      Node currNode = popNode(context.open);
+
+      // Skip stale entries of cells that were reached again at a lower cost
+      CellScratch & scratch = context.scratch[currNode.cell];
+      if (scratch.closed == context.generation || currNode.g > scratch.g) { continue; }
+      scratch.closed = context.generation;
+      countExpanded(context.stats);
+      if (!spendExpansion(context.limits)) { return false; }
+
+      // Check if current node is the goal node
+      if (currNode.cell == goalCell) { return true; }
+
+      // Expand neighbours and add valid nodes to open nodes list
+      expandNeighbours<Neighbourhood, Heuristic>(currNode, goal, grid, context);
+   }
+
+   // No path to goal was found
+   return false;
+}
+
+/*
+ * Jump Point Search (JPS) for the 4-connected grid.
+ *
+ * On a uniform cost grid many shortest paths are symmetric, they
+ * only differ in the order of their horizontal and vertical moves.
+ * JPS only follows the canonical one of those paths, which moves
+ * vertically as early as possible:
+ *   - a vertical move may be followed by a move in any direction
+ *     other than backwards
+ *   - a horizontal move is only followed by a vertical move when
+ *     that turn is forced, i.e. the cell next to the previous cell
+ *     in that vertical direction is an obstacle
+ * Instead of pushing every cell, the search jumps along straight
+ * lines and only pushes the jump points where the canonical path
+ * can turn. g and h stay in steps, so the path length is the same
+ * as the one found by searchPath while far fewer nodes are expanded.
+ */
+
+/*
+ * Returns true if a path moving horizontally from cell prev onto
+ * cell next is forced to turn into the vertical direction given
+ * as a cell offset.
+ */
+bool forcedTurn(int prev, int next, int vertical, const Grid & grid) {
+   return validOpenNodePos(next + vertical, grid) &&
+          !validOpenNodePos(prev + vertical, grid);
+}
+
+/*
+ * Word-parallel version of jumpHorizontal on the occupancy layer.
+ * Every iteration checks the next 64 cells of the row at once: the
+ * obstacles of the row give the first wall, and the obstacles of the
+ * rows above and below give every forced turn in that stretch.
+ * Moving left the windows are read so that bit 63 is the cell
+ * nearest to the starting cell.
+ */
+int jumpHorizontalBits(int cell, int step, int goalCell, const Grid & grid) {
+   const OccupancyBitmap & occupancy = grid.occupancy;
+   int stride = grid.stride;
+   if (step > 0) {
+      for (int next = cell + 1; ; next += 64) {
+         uint64_t walls = occupancyWindow(occupancy, next);
+         uint64_t stops =
+            (~occupancyWindow(occupancy, next - stride) & occupancyWindow(occupancy, next - 1 - stride)) |
+            (~occupancyWindow(occupancy, next + stride) & occupancyWindow(occupancy, next - 1 + stride));
+         unsigned goalDistance = goalCell - next;
+         if (goalDistance < 64) { stops |= uint64_t{1} << goalDistance; }
+         int stop = lowestBit(stops); int wall = lowestBit(walls);
+         if (stop < wall) { return next + stop; }
+         if (wall < 64) { return -1; }
+      }
+   } else {
+      for (int next = cell - 1; ; next -= 64) {
+         int first = next - 63;
+         uint64_t walls = occupancyWindow(occupancy, first);
+         uint64_t stops =
+            (~occupancyWindow(occupancy, first - stride) & occupancyWindow(occupancy, first + 1 - stride)) |
+            (~occupancyWindow(occupancy, first + stride) & occupancyWindow(occupancy, first + 1 + stride));
+         unsigned goalDistance = next - goalCell;
+         if (goalDistance < 64) { stops |= uint64_t{1} << (63 - goalDistance); }
+         int stop = highestBit(stops); int wall = highestBit(walls);
+         if (stop < wall) { return next - stop; }
+         if (wall < 64) { return -1; }
+      }
+   }
+}
+
+/*
+ * Moves horizontally from the given cell by step (+1 or -1) and
+ * returns the first jump point on the way: the goal cell or a
+ * cell with a forced turn. Returns -1 if an obstacle is hit first.
+ * Uses the word-parallel scan when the grid has an occupancy layer.
+ */
+int jumpHorizontal(int cell, int step, int goalCell, const Grid & grid) {
+   if (!grid.occupancy.words.empty()) {
+      return jumpHorizontalBits(cell, step, goalCell, grid);
+   }
+   for (;;) {
+      int next = cell + step;
+      if (!validOpenNodePos(next, grid)) { return -1; }
+      if (next == goalCell ||
+          forcedTurn(cell, next, -grid.stride, grid) ||
+          forcedTurn(cell, next, grid.stride, grid)) {
+         return next;
+      }
+      cell = next;
+   }
+}
+
+/*
+ * Moves vertically from the given cell by step (+stride or -stride)
+ * and returns the first jump point on the way: the goal cell or a
+ * cell from which a horizontal jump reaches a jump point.
+ * Returns -1 if an obstacle is hit first.
+ */
+int jumpVertical(int cell, int step, int goalCell, const Grid & grid) {
+   bool useBits = !grid.occupancy.words.empty();
+   for (;;) {
+      int next = cell + step;
+      if (useBits ? !validOpenNodePos(next, grid.occupancy)
+                  : !validOpenNodePos(next, grid)) { return -1; }
+      if (next == goalCell ||
+          jumpHorizontal(next, 1, goalCell, grid) != -1 ||
+          jumpHorizontal(next, -1, goalCell, grid) != -1) {
+         return next;
+      }
+      cell = next;
+   }
+}
+
+/*
+ * Adds the given jump point to the open list of the context if it
+ * is reached at a lower cost than before. Straight line jumps cost
+ * their Manhattan distance.
+ */
+template <typename OpenList>
+void addJumpPoint(const Node & currNode, int jumpPoint, const int goal[2],
+                  const Grid & grid, SearchContext<OpenList> & context) {
+   if (jumpPoint == -1) { return; }
+   const CellScratch & scratch = context.scratch[jumpPoint];
+   if (scratch.closed == context.generation) { return; }
+   int x = cellX(grid, jumpPoint); int y = cellY(grid, jumpPoint);
+   int g = currNode.g + heuristic(x, y, cellX(grid, currNode.cell), cellY(grid, currNode.cell));
+   if (scratch.seen == context.generation && scratch.g <= g) { return; }
+   Node node{jumpPoint, g, g + heuristic(x, y, goal[0], goal[1])};
+   addToOpenNodes(node, currNode.cell, context);
+}
+
+/*
+ * Finds the optimum path between start and finish points in
+ * the given grid using Jump Point Search. Works like searchPath
+ * but the parent links of the context connect jump points.
+ * extractPath fills in the straight runs between them.
+ */
+template <typename OpenList>
+bool jumpPointSearch(const Grid & grid, SearchContext<OpenList> & context,
+                     const int init[2], const int goal[2]) {
+   beginQuery(context, grid);
+
+   int h = heuristic(init[0], init[1], goal[0], goal[1]);
+   Node startNode{cellIndex(grid, init[0], init[1]), 0, h};
+   int goalCell = cellIndex(grid, goal[0], goal[1]);
+   addToOpenNodes(startNode, -1, context);
+
+   while(!openListEmpty(context.open)) {
+      Node currNode = popNode(context.open);
+
+      // Skip stale entries of cells that were reached again at a lower cost
+      CellScratch & scratch = context.scratch[currNode.cell];
+      if (scratch.closed == context.generation || currNode.g > scratch.g) { continue; }
+      scratch.closed = context.generation;
+      countExpanded(context.stats);
+      if (!spendExpansion(context.limits)) { return false; }
+
+      if (currNode.cell == goalCell) { return true; }
+
+      int cell = currNode.cell;
+      int parent = scratch.parent;
+      int stride = grid.stride;
+      if (parent == -1) {
+         // Starting node. Jump in all four directions
+         addJumpPoint(currNode, jumpHorizontal(cell, 1, goalCell, grid), goal, grid, context);
+         addJumpPoint(currNode, jumpHorizontal(cell, -1, goalCell, grid), goal, grid, context);
+         addJumpPoint(currNode, jumpVertical(cell, stride, goalCell, grid), goal, grid, context);
+         addJumpPoint(currNode, jumpVertical(cell, -stride, goalCell, grid), goal, grid, context);
+      } else if (abs(cell - parent) < stride) {
+         // Reached by a horizontal move. Keep going and take the forced turns
+         int step = (cell > parent) ? 1 : -1;
+         addJumpPoint(currNode, jumpHorizontal(cell, step, goalCell, grid), goal, grid, context);
+         for (int vertical : {-stride, stride}) {
+            if (forcedTurn(cell - step, cell, vertical, grid)) {
+               addJumpPoint(currNode, jumpVertical(cell, vertical, goalCell, grid), goal, grid, context);
+            }
+         }
+      } else {
+         // Reached by a vertical move. Keep going or turn to either side
+         int step = (cell > parent) ? stride : -stride;
+         addJumpPoint(currNode, jumpVertical(cell, step, goalCell, grid), goal, grid, context);
+         addJumpPoint(currNode, jumpHorizontal(cell, 1, goalCell, grid), goal, grid, context);
+         addJumpPoint(currNode, jumpHorizontal(cell, -1, goalCell, grid), goal, grid, context);
+      }
+   }
+
+   // No path to goal was found
+   return false;
+}
+
+/*
+ * Hierarchical path finding (HPA*).
+ *
+ * buildHierarchy precomputes the abstract graph of a grid once per
+ * map. A query links its start and goal to the entrance nodes of
+ * their clusters, searches the small abstract graph with A* and
+ * then refines every abstract edge into cells with a search that
+ * stays inside the cluster of that edge. The result is close to,
+ * but not always exactly, the optimum path length.
+ * The hierarchy must be rebuilt whenever obstacles of the grid change.
+ */
+const int kClusterSize = 16;
+// Border gaps at least this wide get an entrance at each end instead of one in the middle
+const int kWideEntrance = 6;
+
+/*
+ * Returns the index of the cluster that holds the given cell
+ */
+int clusterOf(const Grid & grid, const Hierarchy & hierarchy, int cell) {
+   int x = cellX(grid, cell); int y = cellY(grid, cell);
+   return (x / hierarchy.clusterSize) * hierarchy.clusterColumns + y / hierarchy.clusterSize;
+}
+
+/*
+ * Breadth first search from the given cell that never leaves the
+ * given cluster. Distances and parent links are left in the cell
+ * scratch of the context.
+ */
+template <typename OpenList>
+void clusterSearch(const Grid & grid, const Hierarchy & hierarchy, int cluster,
+                   int source, SearchContext<OpenList> & context) {
+   int size = hierarchy.clusterSize;
+   int x0 = (cluster / hierarchy.clusterColumns) * size;
+   int y0 = (cluster % hierarchy.clusterColumns) * size;
+   int x1 = std::min(x0 + size, grid.rows);
+   int y1 = std::min(y0 + size, grid.columns);
+
+   beginQuery(context, grid);
+   vector<int32_t> & queue = context.hierarchy.queue;
+   queue.clear();
+   queue.push_back(source);
+   context.scratch[source] = CellScratch{context.generation, 0, 0, -1};
+   for (size_t head = 0; head < queue.size(); head++) {
+      int cell = queue[head];
+      int x = cellX(grid, cell); int y = cellY(grid, cell);
+      int g = context.scratch[cell].g + 1;
+      for (int i=0; i<4; i++) {
+         int nx = x + direction_delta[i][0];
+         int ny = y + direction_delta[i][1];
+         if (nx < x0 || nx >= x1 || ny < y0 || ny >= y1) { continue; }
+         int next = cellIndex(grid, nx, ny);
+         CellScratch & scratch = context.scratch[next];
+         if (!validOpenNodePos(next, grid) || scratch.seen == context.generation) { continue; }
+         scratch = CellScratch{context.generation, 0, g, cell};
+         queue.push_back(next);
+      }
+   }
+}
+
+/*
+ * Builds the abstract graph of the given grid and stores it in
+ * grid.hierarchy.
+ */
+void buildHierarchy(Grid & grid, int clusterSize = kClusterSize) {
+   Hierarchy hierarchy;
+   hierarchy.clusterSize = clusterSize;
+   hierarchy.clusterRows = (grid.rows + clusterSize - 1) / clusterSize;
+   hierarchy.clusterColumns = (grid.columns + clusterSize - 1) / clusterSize;
+
+   // Entrance nodes by cell and the edges between them
+   std::unordered_map<int32_t, int32_t> nodeOfCell;
+   vector<std::pair<int32_t, HierarchyEdge>> edges;
+   auto nodeId = [&](int cell) {
+      auto inserted = nodeOfCell.emplace(cell, hierarchy.nodeCells.size());
+      if (inserted.second) { hierarchy.nodeCells.push_back(cell); }
+      return inserted.first->second;
+   };
+   auto addTransition = [&](int a, int b) {
+      int nodeA = nodeId(a); int nodeB = nodeId(b);
+      edges.push_back({nodeA, HierarchyEdge{nodeB, 1}});
+      edges.push_back({nodeB, HierarchyEdge{nodeA, 1}});
+   };
+
+   /*
+    * Scans a border of the given length between two clusters. Cell i
+    * of the border is at first + i * step on one side and across + that
+    * on the other side. Every gap of free cell pairs gets transitions.
+    */
+   auto scanBorder = [&](int first, int step, int across, int length) {
+      int gapStart = -1;
+      for (int i = 0; i <= length; i++) {
+         int cell = first + i * step;
+         bool open = i < length && validOpenNodePos(cell, grid) &&
+                     validOpenNodePos(cell + across, grid);
+         if (open && gapStart == -1) { gapStart = i; }
+         if (!open && gapStart != -1) {
+            int gapEnd = i - 1;
+            if (gapEnd - gapStart + 1 >= kWideEntrance) {
+               addTransition(first + gapStart * step, first + gapStart * step + across);
+               addTransition(first + gapEnd * step, first + gapEnd * step + across);
+            } else {
+               int middle = first + (gapStart + gapEnd) / 2 * step;
+               addTransition(middle, middle + across);
+            }
+            gapStart = -1;
+         }
+      }
+   };
+
+   for (int cr = 0; cr < hierarchy.clusterRows; cr++) {
+      for (int cc = 0; cc < hierarchy.clusterColumns; cc++) {
+         int x0 = cr * clusterSize; int y0 = cc * clusterSize;
+         int height = std::min(clusterSize, grid.rows - x0);
+         int width = std::min(clusterSize, grid.columns - y0);
+         if (cc + 1 < hierarchy.clusterColumns) {
+            // Border with the cluster to the right
+            scanBorder(cellIndex(grid, x0, y0 + width - 1), grid.stride, 1, height);
+         }
+         if (cr + 1 < hierarchy.clusterRows) {
+            // Border with the cluster below
+            scanBorder(cellIndex(grid, x0 + height - 1, y0), 1, grid.stride, width);
+         }
+      }
+   }
+
+   // Group the entrance nodes by cluster
+   int clusters = hierarchy.clusterRows * hierarchy.clusterColumns;
+   int nodes = hierarchy.nodeCells.size();
+   vector<int32_t> nodeCluster(nodes);
+   hierarchy.clusterStart.assign(clusters + 1, 0);
+   for (int n = 0; n < nodes; n++) {
+      nodeCluster[n] = clusterOf(grid, hierarchy, hierarchy.nodeCells[n]);
+      hierarchy.clusterStart[nodeCluster[n] + 1]++;
+   }
+   for (int c = 0; c < clusters; c++) { hierarchy.clusterStart[c + 1] += hierarchy.clusterStart[c]; }
+   hierarchy.clusterNodes.resize(nodes);
+   vector<uint32_t> fill(hierarchy.clusterStart.begin(), hierarchy.clusterStart.end() - 1);
+   for (int n = 0; n < nodes; n++) { hierarchy.clusterNodes[fill[nodeCluster[n]]++] = n; }
+
+   // Link the entrance nodes of every cluster by their distance inside it
+   SearchContext<> context;
+   for (int c = 0; c < clusters; c++) {
+      for (uint32_t i = hierarchy.clusterStart[c]; i < hierarchy.clusterStart[c + 1]; i++) {
+         int from = hierarchy.clusterNodes[i];
+         clusterSearch(grid, hierarchy, c, hierarchy.nodeCells[from], context);
+         for (uint32_t j = hierarchy.clusterStart[c]; j < hierarchy.clusterStart[c + 1]; j++) {
+            int to = hierarchy.clusterNodes[j];
+            const CellScratch & scratch = context.scratch[hierarchy.nodeCells[to]];
+            if (to != from && scratch.seen == context.generation) {
+               edges.push_back({from, HierarchyEdge{to, scratch.g}});
+            }
+         }
+      }
+   }
+
+   // Store the edges in compressed rows
+   std::stable_sort(edges.begin(), edges.end(),
+                    [](const std::pair<int32_t, HierarchyEdge> & a,
+                       const std::pair<int32_t, HierarchyEdge> & b) { return a.first < b.first; });
+   hierarchy.edgeStart.assign(nodes + 1, 0);
+   hierarchy.edges.reserve(edges.size());
+   for (const auto & edge : edges) {
+      hierarchy.edgeStart[edge.first + 1]++;
+      hierarchy.edges.push_back(edge.second);
+   }
+   for (int n = 0; n < nodes; n++) { hierarchy.edgeStart[n + 1] += hierarchy.edgeStart[n]; }
+
+   grid.hierarchy = std::move(hierarchy);
+}
+
+/*
+ * Binary file format of a hierarchy, stored next to its map:
+ * the header followed by nodeCells, edgeStart, edges, clusterStart
+ * and clusterNodes. Values are stored in native byte order.
+ */
+const char kHierarchyFileMagic[4] = {'H', 'P', 'A', 'B'};
+const uint32_t kHierarchyFileVersion = 2;
+
+// fingerprint is the gridFingerprint of the map the hierarchy was built for
+struct HierarchyFileHeader {
+   char magic[4];
+   uint32_t version;
+   uint32_t rows;
+   uint32_t columns;
+   uint32_t stride;
+   uint32_t clusterSize;
+   uint32_t nodeCount;
+   uint32_t edgeCount;
+   uint64_t fingerprint;
+};
+
+/*
+ * Writes the hierarchy of the given grid to the file denoted by
+ * path. Returns false if the file could not be written.
+ */
+bool writeHierarchy(const Grid & grid, const string & path) {
+   const Hierarchy & hierarchy = grid.hierarchy;
+   HierarchyFileHeader header{};
+   std::memcpy(header.magic, kHierarchyFileMagic, sizeof(header.magic));
+   header.version = kHierarchyFileVersion;
+   header.rows = grid.rows;
+   header.columns = grid.columns;
+   header.stride = grid.stride;
+   header.clusterSize = hierarchy.clusterSize;
+   header.nodeCount = hierarchy.nodeCells.size();
+   header.edgeCount = hierarchy.edges.size();
+   header.fingerprint = gridFingerprint(grid);
+
+   std::ofstream bFile(path, std::ios::binary | std::ios::trunc);
+   auto write = [&](const void * data, size_t size) {
+      bFile.write(static_cast<const char *>(data), size);
+   };
+   write(&header, sizeof(header));
+   write(hierarchy.nodeCells.data(), hierarchy.nodeCells.size() * sizeof(int32_t));
+   write(hierarchy.edgeStart.data(), hierarchy.edgeStart.size() * sizeof(uint32_t));
+   write(hierarchy.edges.data(), hierarchy.edges.size() * sizeof(HierarchyEdge));
+   write(hierarchy.clusterStart.data(), hierarchy.clusterStart.size() * sizeof(uint32_t));
+   write(hierarchy.clusterNodes.data(), hierarchy.clusterNodes.size() * sizeof(int32_t));
+   return static_cast<bool>(bFile);
+}
+
+/*
+ * Reads the hierarchy file denoted by path into grid.hierarchy.
+ * The file must have been written for the same map, checked by its
+ * fingerprint. Returns false and leaves the grid untouched if the
+ * file is missing, invalid or built for another map.
+ */
+bool readHierarchy(Grid & grid, const string & path) {
+   std::ifstream bFile(path, std::ios::binary);
+   HierarchyFileHeader header{};
+   if (!bFile.read(reinterpret_cast<char *>(&header), sizeof(header))) { return false; }
+   if (std::memcmp(header.magic, kHierarchyFileMagic, sizeof(header.magic)) != 0 ||
+       header.version != kHierarchyFileVersion ||
+       header.rows != static_cast<uint32_t>(grid.rows) ||
+       header.columns != static_cast<uint32_t>(grid.columns) ||
+       header.stride != static_cast<uint32_t>(grid.stride) ||
+       header.clusterSize == 0 || header.nodeCount > grid.cells.size() ||
+       header.fingerprint != gridFingerprint(grid)) {
+      return false;
+   }
+
+   Hierarchy hierarchy;
+   hierarchy.clusterSize = header.clusterSize;
+   hierarchy.clusterRows = (grid.rows + hierarchy.clusterSize - 1) / hierarchy.clusterSize;
+   hierarchy.clusterColumns = (grid.columns + hierarchy.clusterSize - 1) / hierarchy.clusterSize;
+   size_t clusters = size_t(hierarchy.clusterRows) * hierarchy.clusterColumns;
+   hierarchy.nodeCells.resize(header.nodeCount);
+   hierarchy.edgeStart.resize(header.nodeCount + 1);
+   hierarchy.edges.resize(header.edgeCount);
+   hierarchy.clusterStart.resize(clusters + 1);
+   hierarchy.clusterNodes.resize(header.nodeCount);
+   auto read = [&](void * data, size_t size) {
+      return static_cast<bool>(bFile.read(static_cast<char *>(data), size));
+   };
+   if (!read(hierarchy.nodeCells.data(), hierarchy.nodeCells.size() * sizeof(int32_t)) ||
+       !read(hierarchy.edgeStart.data(), hierarchy.edgeStart.size() * sizeof(uint32_t)) ||
+       !read(hierarchy.edges.data(), hierarchy.edges.size() * sizeof(HierarchyEdge)) ||
+       !read(hierarchy.clusterStart.data(), hierarchy.clusterStart.size() * sizeof(uint32_t)) ||
+       !read(hierarchy.clusterNodes.data(), hierarchy.clusterNodes.size() * sizeof(int32_t))) {
+      return false;
+   }
+
+   // Every index must stay in range, searches do not check them
+   for (int32_t cell : hierarchy.nodeCells) {
+      if (cell < 0 || cell >= static_cast<int32_t>(grid.cells.size()) ||
+          !validOpenNodePos(cell, grid)) { return false; }
+   }
+   auto ordered = [](const vector<uint32_t> & starts, size_t last) {
+      if (starts.front() != 0 || starts.back() != last) { return false; }
+      return std::is_sorted(starts.begin(), starts.end());
+   };
+   if (!ordered(hierarchy.edgeStart, header.edgeCount) ||
+       !ordered(hierarchy.clusterStart, header.nodeCount)) { return false; }
+   for (const HierarchyEdge & edge : hierarchy.edges) {
+      if (edge.to < 0 || edge.to >= static_cast<int32_t>(header.nodeCount) || edge.cost < 1) {
+         return false;
+      }
+   }
+   for (int32_t node : hierarchy.clusterNodes) {
+      if (node < 0 || node >= static_cast<int32_t>(header.nodeCount)) { return false; }
+   }
+   grid.hierarchy = std::move(hierarchy);
+   return true;
+}
+
+/*
+ * Finds a path between start and finish points in the given grid
+ * using the hierarchy of the grid. Like the other engines it leaves
+ * parent links from start to goal in the cell scratch of the context,
+ * with g holding the path length. Falls back to searchPath if no
+ * hierarchy has been built for the grid. Returns false if an edge of
+ * the abstract path cannot be refined, as happens with a hierarchy
+ * that went stale after obstacle changes.
+ */
+template <typename OpenList>
+bool hierarchicalSearch(const Grid & grid, SearchContext<OpenList> & context,
+                        const int init[2], const int goal[2]) {
+   const Hierarchy & hierarchy = grid.hierarchy;
+   if (hierarchy.clusterSize == 0) { return searchPath(grid, context, init, goal); }
+
+   HierarchyScratch & work = context.hierarchy;
+   int startCell = cellIndex(grid, init[0], init[1]);
+   int goalCell = cellIndex(grid, goal[0], goal[1]);
+   int startCluster = clusterOf(grid, hierarchy, startCell);
+   int goalCluster = clusterOf(grid, hierarchy, goalCell);
+
+   // Link the start and goal to the entrance nodes of their clusters
+   int direct = -1;
+   auto linkCluster = [&](int cluster, int cell, vector<HierarchyEdge> & links) {
+      clusterSearch(grid, hierarchy, cluster, cell, context);
+      links.clear();
+      for (uint32_t i = hierarchy.clusterStart[cluster]; i < hierarchy.clusterStart[cluster + 1]; i++) {
+         int node = hierarchy.clusterNodes[i];
+         const CellScratch & scratch = context.scratch[hierarchy.nodeCells[node]];
+         if (scratch.seen == context.generation) { links.push_back(HierarchyEdge{node, scratch.g}); }
+      }
+   };
+   linkCluster(goalCluster, goalCell, work.goalLinks);
+   linkCluster(startCluster, startCell, work.startLinks);
+   if (startCluster == goalCluster && context.scratch[goalCell].seen == context.generation) {
+      direct = context.scratch[goalCell].g;
+   }
+
+   // A* over the abstract graph with the start and goal as two extra nodes
+   int nodes = hierarchy.nodeCells.size();
+   int startNode = nodes; int goalNode = nodes + 1;
+   if (work.scratch.size() != size_t(nodes + 2)) {
+      work.scratch.assign(nodes + 2, CellScratch{});
+      work.generation = 0;
+   }
+   nextGeneration(work.generation, work.scratch);
+   clearOpenList(context.open);
+   auto nodeCell = [&](int node) {
+      return node == startNode ? startCell : node == goalNode ? goalCell : hierarchy.nodeCells[node];
+   };
+   auto relax = [&](int from, int to, int g) {
+      CellScratch & scratch = work.scratch[to];
+      if (scratch.closed == work.generation ||
+          (scratch.seen == work.generation && scratch.g <= g)) { return; }
+      scratch.seen = work.generation; scratch.g = g; scratch.parent = from;
+      int cell = nodeCell(to);
+      int h = heuristic(cellX(grid, cell), cellY(grid, cell), goal[0], goal[1]);
+      pushNode(context.open, Node{to, g, g + h});
+      countPushed(context.stats, openListSize(context.open));
+   };
+   work.scratch[startNode] = CellScratch{work.generation, 0, 0, -1};
+   pushNode(context.open, Node{startNode, 0, 0});
+   countPushed(context.stats, openListSize(context.open));
+   bool found = false;
+   while (!openListEmpty(context.open)) {
+      Node currNode = popNode(context.open);
+      CellScratch & scratch = work.scratch[currNode.cell];
+      if (scratch.closed == work.generation || currNode.g > scratch.g) { continue; }
+      scratch.closed = work.generation;
+      countExpanded(context.stats);
+      if (!spendExpansion(context.limits)) { return false; }
+      if (currNode.cell == goalNode) { found = true; break; }
+      if (currNode.cell == startNode) {
+         for (const HierarchyEdge & edge : work.startLinks) {
+            relax(startNode, edge.to, currNode.g + edge.cost);
+         }
+         if (direct != -1) { relax(startNode, goalNode, direct); }
+         continue;
+      }
+      for (uint32_t e = hierarchy.edgeStart[currNode.cell]; e < hierarchy.edgeStart[currNode.cell + 1]; e++) {
+         relax(currNode.cell, hierarchy.edges[e].to, currNode.g + hierarchy.edges[e].cost);
+      }
+      for (const HierarchyEdge & edge : work.goalLinks) {
+         if (edge.to == currNode.cell) { relax(currNode.cell, goalNode, currNode.g + edge.cost); }
+      }
+   }
+   if (!found) { return false; }
+
+   work.abstractPath.clear();
+   for (int node = goalNode; node != -1; node = work.scratch[node].parent) {
+      work.abstractPath.push_back(nodeCell(node));
+   }
+   std::reverse(work.abstractPath.begin(), work.abstractPath.end());
+
+   // Refine every abstract edge into cells
+   work.path.assign(1, startCell);
+   for (size_t i = 1; i < work.abstractPath.size(); i++) {
+      int from = work.abstractPath[i - 1]; int to = work.abstractPath[i];
+      int cluster = clusterOf(grid, hierarchy, from);
+      if (cluster != clusterOf(grid, hierarchy, to)) {
+         work.path.push_back(to);  // Step across a cluster border
+         continue;
+      }
+      clusterSearch(grid, hierarchy, cluster, from, context);
+      // A hierarchy gone stale after changes of the grid may hold edges that no longer exist
+      if (context.scratch[to].seen != context.generation) { return false; }
+      size_t segmentStart = work.path.size();
+      for (int cell = to; cell != from; cell = context.scratch[cell].parent) {
+         work.path.push_back(cell);
+      }
+      std::reverse(work.path.begin() + segmentStart, work.path.end());
+   }
+
+   // Leave the refined path as parent links like the other engines.
+   // Segments refined on their own can pass a cell twice, which would
+   // close a loop of parent links, so such loops are cut out here.
+   beginQuery(context, grid);
+   size_t length = 0;
+   for (size_t i = 0; i < work.path.size(); i++) {
+      int cell = work.path[i];
+      CellScratch & scratch = context.scratch[cell];
+      if (scratch.seen == context.generation && size_t(scratch.g) < length &&
+          work.path[scratch.g] == cell) { length = scratch.g; }
+      int parent = (length == 0) ? -1 : work.path[length - 1];
+      work.path[length] = cell;
+      scratch = CellScratch{context.generation, context.generation, static_cast<int32_t>(length), parent};
+      length++;
+   }
+   work.path.resize(length);
+   return true;
+}
+
+/*
+ * Bidirectional A* search.
+ *
+ * Runs one A* from the start towards the goal and one from the
+ * goal towards the start, expanding one node of each in turn. Every
+ * cell reached by both searches gives a candidate path length mu.
+ * With a consistent heuristic no path shorter than mu can remain
+ * once the lowest f of either open list is at least mu, or once the
+ * lowest g values of both open lists plus one step add up to mu.
+ * The search stops there and the result is still optimum. The second
+ * bound is what stops the search early in long corridors, where the
+ * heuristic is poor and f stays low.
+ */
+
+/*
+ * Helper functions to keep the depth counts of one half in step
+ * with its open list
+ */
+void addDepth(DepthCounts & depths, int g) {
+   if (g >= static_cast<int>(depths.count.size())) { depths.count.resize(g + 1, 0); }
+   depths.count[g]++;
+   // A* pops by f, so a new node can lie below the lowest depth so far
+   depths.minDepth = std::min(depths.minDepth, g);
+}
+
+void removeDepth(DepthCounts & depths, int g) {
+   depths.count[g]--;
+   int size = depths.count.size();
+   while (depths.minDepth < size && depths.count[depths.minDepth] == 0) { depths.minDepth++; }
+}
+
+/*
+ * Expands the lowest open node of one half of the bidirectional
+ * search. target is the goal of this half and other the scratch of
+ * the opposite half, used to update the best meeting cell.
+ * Returns false once this half can no longer improve on best.
+ * Expansions and pushes are counted into stats.
+ */
+template <typename OpenList>
+bool expandBidirectional(const Grid & grid, OpenList & open, DepthCounts & depths,
+                         vector<CellScratch> & own, uint32_t generation,
+                         const vector<CellScratch> & other, uint32_t otherGeneration,
+                         const int target[2], int & best, int & meetCell,
+                         SearchStats & stats) {
+   int offsets[4];
+   neighbourOffsets(grid, offsets);
+   while (!openListEmpty(open)) {
+      Node currNode = popNode(open);
+      removeDepth(depths, currNode.g);
+      CellScratch & scratch = own[currNode.cell];
+      if (scratch.closed == generation || currNode.g > scratch.g) { continue; }
+      if (currNode.f >= best) { return false; }
+      scratch.closed = generation;
+      countExpanded(stats);
+
+      int currX = cellX(grid, currNode.cell);
+      int currY = cellY(grid, currNode.cell);
+      for (int i=0; i<4; i++) {
+         int cell = currNode.cell + offsets[i];
+         if (!validOpenNodePos(cell, grid)) { continue; }
+         CellScratch & next = own[cell];
+         int g = currNode.g + 1;
+         if (next.closed == generation ||
+             (next.seen == generation && next.g <= g)) { continue; }
+         next.seen = generation; next.g = g; next.parent = currNode.cell;
+         int h = heuristic(currX + direction_delta[i][0], currY + direction_delta[i][1],
+                           target[0], target[1]);
+         pushNode(open, Node{cell, g, g + h});
+         countPushed(stats, openListSize(open));
+         addDepth(depths, g);
+         if (other[cell].seen == otherGeneration && g + other[cell].g < best) {
+            best = g + other[cell].g;
+            meetCell = cell;
+         }
+      }
+      return true;
+   }
+   return false;
+}
+
+/*
+ * Finds the optimum path between start and finish points in the
+ * given grid using bidirectional A*. Like the other engines it
+ * leaves parent links from start to goal in the cell scratch of
+ * the context.
+ */
+template <typename OpenList>
+bool bidirectionalSearch(const Grid & grid, SearchContext<OpenList> & context,
+                         const int init[2], const int goal[2]) {
+   beginQuery(context, grid);
+   if (context.reverseScratch.size() != grid.cells.size()) {
+      context.reverseScratch.assign(grid.cells.size(), CellScratch{});
+      context.reverseGeneration = 0;
+   }
+   nextGeneration(context.reverseGeneration, context.reverseScratch);
+   clearOpenList(context.reverseOpen);
+   uint32_t forward = context.generation;
+   uint32_t backward = context.reverseGeneration;
+
+   int startCell = cellIndex(grid, init[0], init[1]);
+   int goalCell = cellIndex(grid, goal[0], goal[1]);
+   int h = heuristic(init[0], init[1], goal[0], goal[1]);
+   context.scratch[startCell] = CellScratch{forward, 0, 0, -1};
+   context.reverseScratch[goalCell] = CellScratch{backward, 0, 0, -1};
+   pushNode(context.open, Node{startCell, 0, h});
+   pushNode(context.reverseOpen, Node{goalCell, 0, h});
+   countPushed(context.stats, 1);
+   countPushed(context.stats, 1);
+   DepthCounts & forwardDepths = context.depths[0];
+   DepthCounts & backwardDepths = context.depths[1];
+   for (DepthCounts * depths : {&forwardDepths, &backwardDepths}) {
+      depths->count.clear();
+      depths->minDepth = 0;
+      addDepth(*depths, 0);
+   }
+
+   int best = (startCell == goalCell) ? 0 : kUnreachable;
+   int meetCell = startCell;
+   for (;;) {
+      // Each round expands a node of both halves
+      if (!spendExpansion(context.limits) || !spendExpansion(context.limits)) { return false; }
+      if (!expandBidirectional(grid, context.open, forwardDepths, context.scratch, forward,
+                               context.reverseScratch, backward, goal, best, meetCell,
+                               context.stats) ||
+          best <= forwardDepths.minDepth + backwardDepths.minDepth + 1) { break; }
+      if (!expandBidirectional(grid, context.reverseOpen, backwardDepths, context.reverseScratch,
+                               backward, context.scratch, forward, init, best, meetCell,
+                               context.stats) ||
+          best <= forwardDepths.minDepth + backwardDepths.minDepth + 1) { break; }
+   }
+   if (best == kUnreachable) { return false; }
+
+   // Continue the forward parent links along the backward half to the goal
+   for (int cell = meetCell; cell != goalCell; ) {
+      int next = context.reverseScratch[cell].parent;
+      CellScratch & scratch = context.scratch[next];
+      scratch.seen = forward;
+      scratch.g = context.scratch[cell].g + 1;
+      scratch.parent = cell;
+      cell = next;
+   }
+   return true;
+}
+
+/*
+ * Fork-join pool of worker threads. runPool runs job(t) for every
+ * thread t of the pool, the calling thread being thread 0, and
+ * returns once all of them are done. Workers sleep between rounds,
+ * so a pool can be kept around for many short rounds.
+ */
+struct WorkerPool {
+   unsigned size = 1;
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::condition_variable finished;
+   std::function<void(unsigned)> job;
+   uint64_t round = 0;
+   unsigned pending = 0;
+   bool stop = false;
+   vector<std::thread> threads;
+};
+
+void startPool(WorkerPool & pool, unsigned size) {
+   pool.size = std::max(1u, size);
+   for (unsigned t = 1; t < pool.size; t++) {
+      pool.threads.emplace_back([&pool, t]() {
+         uint64_t seen = 0;
+         for (;;) {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.wake.wait(lock, [&]() { return pool.stop || pool.round != seen; });
+            if (pool.stop) { return; }
+            seen = pool.round;
+            lock.unlock();
+            pool.job(t);
+            lock.lock();
+            if (--pool.pending == 0) { pool.finished.notify_one(); }
+         }
+      });
+   }
+}
+
+void runPool(WorkerPool & pool, const std::function<void(unsigned)> & job) {
+   if (pool.size == 1) {
+      job(0);
+      return;
+   }
+   {
+      std::lock_guard<std::mutex> lock(pool.mutex);
+      pool.job = job;
+      pool.pending = pool.size - 1;
+      pool.round++;
+   }
+   pool.wake.notify_all();
+   job(0);
+   std::unique_lock<std::mutex> lock(pool.mutex);
+   pool.finished.wait(lock, [&]() { return pool.pending == 0; });
+}
+
+void stopPool(WorkerPool & pool) {
+   {
+      std::lock_guard<std::mutex> lock(pool.mutex);
+      pool.stop = true;
+   }
+   pool.wake.notify_all();
+   for (auto & thread : pool.threads) { thread.join(); }
+   pool.threads.clear();
+}
+
+/*
+ * Vector kernels of distanceField. With PLANNER_SIMD (the default)
+ * x86-64 builds get AVX2 versions, picked at run time when the CPU
+ * supports them, and AArch64 builds always use NEON. Everything else
+ * and -DPLANNER_SIMD=0 builds run the scalar versions.
+ *   fillMasked    : writes value to out[b] for every bit b set in bits
+ *   bottomUpWords : one bottom-up level over the bitmap words from
+ *                   begin to end, see distanceField
+ */
+#if PLANNER_AVX2
+const bool kCpuHasAvx2 = __builtin_cpu_supports("avx2");
+#endif
+
+// Masks with fewer cells are written one cell at a time
+const int kFieldDenseBits = 8;
+
+template <typename T>
+void fillMaskedScalar(T * out, uint64_t bits, T value) {
+   for (; bits != 0; bits &= bits - 1) { out[lowestBit(bits)] = value; }
+}
+
+#if PLANNER_AVX2
+__attribute__((target("avx2")))
+void fillMaskedAvx2(uint32_t * out, uint64_t bits, uint32_t value) {
+   const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+   const __m256i values = _mm256_set1_epi32(value);
+   for (int i = 0; i < 64; i += 8, bits >>= 8) {
+      __m256i mask = _mm256_and_si256(_mm256_set1_epi32(bits & 0xFF), lanes);
+      mask = _mm256_cmpeq_epi32(mask, lanes);
+      _mm256_maskstore_epi32(reinterpret_cast<int *>(out + i), mask, values);
+   }
+}
+
+__attribute__((target("avx2")))
+void fillMaskedAvx2(uint16_t * out, uint64_t bits, uint16_t value) {
+   const __m256i lanes = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048,
+                                           4096, 8192, 16384, -32768);
+   const __m256i values = _mm256_set1_epi16(value);
+   for (int i = 0; i < 64; i += 16, bits >>= 16) {
+      if ((bits & 0xFFFF) == 0) { continue; }
+      __m256i mask = _mm256_and_si256(_mm256_set1_epi16(bits & 0xFFFF), lanes);
+      mask = _mm256_cmpeq_epi16(mask, lanes);
+      __m256i * target = reinterpret_cast<__m256i *>(out + i);
+      _mm256_storeu_si256(target, _mm256_blendv_epi8(_mm256_loadu_si256(target), values, mask));
+   }
+}
+#elif PLANNER_NEON
+void fillMaskedNeon(uint32_t * out, uint64_t bits, uint32_t value) {
+   const uint32_t lanes[4] = {1, 2, 4, 8};
+   const uint32x4_t lane = vld1q_u32(lanes);
+   const uint32x4_t values = vdupq_n_u32(value);
+   for (int i = 0; i < 64; i += 4, bits >>= 4) {
+      if ((bits & 0xF) == 0) { continue; }
+      uint32x4_t mask = vtstq_u32(vdupq_n_u32(bits & 0xF), lane);
+      vst1q_u32(out + i, vbslq_u32(mask, values, vld1q_u32(out + i)));
+   }
+}
+
+void fillMaskedNeon(uint16_t * out, uint64_t bits, uint16_t value) {
+   const uint16_t lanes[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+   const uint16x8_t lane = vld1q_u16(lanes);
+   const uint16x8_t values = vdupq_n_u16(value);
+   for (int i = 0; i < 64; i += 8, bits >>= 8) {
+      if ((bits & 0xFF) == 0) { continue; }
+      uint16x8_t mask = vtstq_u16(vdupq_n_u16(bits & 0xFF), lane);
+      vst1q_u16(out + i, vbslq_u16(mask, values, vld1q_u16(out + i)));
+   }
+}
+#endif
+
+template <typename T>
+void fillMasked(T * out, uint64_t bits, T value) {
+   if (__builtin_popcountll(bits) < kFieldDenseBits) {
+      fillMaskedScalar(out, bits, value);
+      return;
+   }
+#if PLANNER_AVX2
+   if (kCpuHasAvx2) {
+      fillMaskedAvx2(out, bits, value);
+      return;
+   }
+#elif PLANNER_NEON
+   fillMaskedNeon(out, bits, value);
+   return;
+#endif
+   fillMaskedScalar(out, bits, value);
+}
+
+/*
+ * Helper function of bottomUpWords for one word: marks the cells
+ * found in word w visited and writes their distance. Returns the
+ * number of cells found.
+ */
+template <typename T>
+size_t bottomUpWord(size_t w, uint64_t found, uint64_t * visited, uint64_t * nextBits,
+                    T * distance, T value) {
+   nextBits[w] = found;
+   if (found == 0) { return 0; }
+   visited[w] |= found;
+   fillMasked(distance + w * 64, found, value);
+   return __builtin_popcountll(found);
+}
+
+template <typename T>
+size_t bottomUpWordsScalar(const uint64_t * bits, size_t rowWords, size_t begin, size_t end,
+                           uint64_t * visited, uint64_t * nextBits, T * distance, T value) {
+   size_t count = 0;
+   for (size_t w = begin; w < end; w++) {
+      uint64_t reach = bits[w - rowWords] | bits[w + rowWords] |
+                       (bits[w] << 1) | (bits[w - 1] >> 63) |
+                       (bits[w] >> 1) | (bits[w + 1] << 63);
+      count += bottomUpWord(w, reach & ~visited[w], visited, nextBits, distance, value);
+   }
+   return count;
+}
+
+#if PLANNER_AVX2
+__attribute__((target("avx2")))
+inline __m256i loadWords(const uint64_t * p) {
+   return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+// Four words per step, with the scalar loop for the rest
+template <typename T>
+__attribute__((target("avx2")))
+size_t bottomUpWordsAvx2(const uint64_t * bits, size_t rowWords, size_t begin, size_t end,
+                         uint64_t * visited, uint64_t * nextBits, T * distance, T value) {
+   size_t count = 0;
+   size_t w = begin;
+   for (; w + 4 <= end; w += 4) {
+      __m256i here = loadWords(bits + w);
+      __m256i reach = _mm256_or_si256(loadWords(bits + w - rowWords), loadWords(bits + w + rowWords));
+      reach = _mm256_or_si256(reach, _mm256_or_si256(_mm256_slli_epi64(here, 1),
+                                                     _mm256_srli_epi64(here, 1)));
+      reach = _mm256_or_si256(reach, _mm256_or_si256(_mm256_srli_epi64(loadWords(bits + w - 1), 63),
+                                                     _mm256_slli_epi64(loadWords(bits + w + 1), 63)));
+      __m256i found = _mm256_andnot_si256(loadWords(visited + w), reach);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(nextBits + w), found);
+      if (_mm256_testz_si256(found, found)) { continue; }
+      alignas(32) uint64_t words[4];
+      _mm256_store_si256(reinterpret_cast<__m256i *>(words), found);
+      for (int i = 0; i < 4; i++) {
+         count += bottomUpWord(w + i, words[i], visited, nextBits, distance, value);
+      }
+   }
+   return count + bottomUpWordsScalar(bits, rowWords, w, end, visited, nextBits, distance, value);
+}
+#elif PLANNER_NEON
+// Two words per step, with the scalar loop for the rest
+template <typename T>
+size_t bottomUpWordsNeon(const uint64_t * bits, size_t rowWords, size_t begin, size_t end,
+                         uint64_t * visited, uint64_t * nextBits, T * distance, T value) {
+   size_t count = 0;
+   size_t w = begin;
+   for (; w + 2 <= end; w += 2) {
+      uint64x2_t here = vld1q_u64(bits + w);
+      uint64x2_t reach = vorrq_u64(vld1q_u64(bits + w - rowWords), vld1q_u64(bits + w + rowWords));
+      reach = vorrq_u64(reach, vorrq_u64(vshlq_n_u64(here, 1), vshrq_n_u64(here, 1)));
+      reach = vorrq_u64(reach, vorrq_u64(vshrq_n_u64(vld1q_u64(bits + w - 1), 63),
+                                         vshlq_n_u64(vld1q_u64(bits + w + 1), 63)));
+      uint64x2_t found = vbicq_u64(reach, vld1q_u64(visited + w));
+      vst1q_u64(nextBits + w, found);
+      if ((vgetq_lane_u64(found, 0) | vgetq_lane_u64(found, 1)) == 0) { continue; }
+      count += bottomUpWord(w, vgetq_lane_u64(found, 0), visited, nextBits, distance, value);
+      count += bottomUpWord(w + 1, vgetq_lane_u64(found, 1), visited, nextBits, distance, value);
+   }
+   return count + bottomUpWordsScalar(bits, rowWords, w, end, visited, nextBits, distance, value);
+}
+#endif
+
+template <typename T>
+size_t bottomUpWords(const uint64_t * bits, size_t rowWords, size_t begin, size_t end,
+                     uint64_t * visited, uint64_t * nextBits, T * distance, T value) {
+#if PLANNER_AVX2
+   if (kCpuHasAvx2) {
+      return bottomUpWordsAvx2(bits, rowWords, begin, end, visited, nextBits, distance, value);
+   }
+#elif PLANNER_NEON
+   return bottomUpWordsNeon(bits, rowWords, begin, end, visited, nextBits, distance, value);
+#endif
+   return bottomUpWordsScalar(bits, rowWords, begin, end, visited, nextBits, distance, value);
+}
+
+/*
+ * Tuning of distanceField
+ *   kFieldChunk          : frontier cells a thread claims at a time
+ *   kFieldParallelCells  : smaller frontiers are expanded by the
+ *                          calling thread alone
+ *   kFieldBottomUpRatio  : levels go bottom-up once the frontier has
+ *                          more cells than 1 / ratio of the bitmap words
+ *   kFieldWordsPerThread : least bitmap words of the grid per thread
+ */
+const size_t kFieldChunk = 1024;
+const size_t kFieldParallelCells = 4096;
+const size_t kFieldBottomUpRatio = 8;
+const size_t kFieldWordsPerThread = 4096;
+
+/*
+ * Fills distance with the number of four-connected steps from the
+ * nearest of the given source cells to every cell of the grid buffer,
+ * using a level synchronous breadth first search spread over the given
+ * number of threads (0 for one per hardware thread). Cells that cannot
+ * be reached, and cells further away than T can hold, get the largest
+ * value of T.
+ * Every level expands the frontier of the one before it in one of two
+ * directions:
+ *   top-down  : threads take chunks of the frontier list and claim the
+ *               unvisited neighbours of its cells with an atomic or on
+ *               the visited bitmap
+ *   bottom-up : once the frontier gets large compared to the grid,
+ *               every thread takes a range of bitmap words and finds
+ *               the unvisited cells next to the frontier bitmap with
+ *               the vector kernels, 64 cells per word and without any
+ *               atomics. As the row stride is a multiple of 64, the
+ *               cells above and below a word are the same bits of the
+ *               words one row stride away.
+ * The frontier is only turned from one form into the other when the
+ * direction changes.
+ */
+template <typename T>
+void distanceField(const Grid & grid, const vector<int32_t> & sources, vector<T> & distance,
+                   unsigned threads = 0) {
+   const T kFar = std::numeric_limits<T>::max();
+   size_t cells = grid.cells.size();
+   size_t words = cells / 64;
+   size_t rowWords = grid.stride / 64;
+   distance.assign(cells, kFar);
+   if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+   threads = std::max<size_t>(1, std::min<size_t>(threads, words / kFieldWordsPerThread));
+   WorkerPool pool;
+   startPool(pool, threads);
+   auto range = [&](unsigned t, size_t count, size_t & begin, size_t & end) {
+      begin = count * t / threads;
+      end = count * (t + 1) / threads;
+   };
+
+   // Obstacles count as visited from the start. The occupancy layer
+   // already has them packed, one word in from the start of its bitmap.
+   bool packed = !grid.occupancy.words.empty();
+   vector<uint64_t> visited(words);
+   runPool(pool, [&](unsigned t) {
+      size_t begin, end;
+      range(t, words, begin, end);
+      for (size_t w = begin; w < end; w++) {
+         if (packed) {
+            visited[w] = grid.occupancy.words[w + 1];
+            continue;
+         }
+         uint64_t bits = 0;
+         for (int b = 0; b < 64; b++) {
+            if (!validOpenNodePos(w * 64 + b, grid)) { bits |= uint64_t{1} << b; }
+         }
+         visited[w] = bits;
+      }
+   });
+
+   vector<int32_t> frontier;
+   for (int32_t source : sources) {
+      uint64_t mask = uint64_t{1} << (source & 63);
+      if ((visited[source >> 6] & mask) != 0) { continue; }
+      visited[source >> 6] |= mask;
+      distance[source] = 0;
+      frontier.push_back(source);
+   }
+   int offsets[4];
+   neighbourOffsets(grid, offsets);
+   vector<uint64_t> frontierBits;
+   vector<uint64_t> nextBits;
+   bool bitsCurrent = false;  // Whether frontierBits holds the frontier instead of frontier
+   size_t count = frontier.size();
+   vector<vector<int32_t>> next(threads);
+   vector<size_t> found(threads);
+   std::atomic<size_t> cursor{0};
+
+   for (uint32_t level = 1; count > 0; level++) {
+      T value = (level < kFar) ? T(level) : kFar;
+      if (count * kFieldBottomUpRatio > words) {
+         if (!bitsCurrent) {
+            frontierBits.assign(words, 0);
+            nextBits.assign(words, 0);
+            for (int32_t cell : frontier) { frontierBits[cell >> 6] |= uint64_t{1} << (cell & 63); }
+            bitsCurrent = true;
+         }
+         runPool(pool, [&](unsigned t) {
+            // Words of the board rows, the sentinel rows never change
+            size_t begin, end;
+            range(t, words - 2 * rowWords, begin, end);
+            found[t] = bottomUpWords(frontierBits.data(), rowWords, rowWords + begin, rowWords + end,
+                                     visited.data(), nextBits.data(), distance.data(), value);
+         });
+         frontierBits.swap(nextBits);
+         count = 0;
+         for (size_t cellsFound : found) { count += cellsFound; }
+         continue;
+      }
+
+      if (bitsCurrent) {
+         frontier.clear();
+         for (size_t w = 0; w < words; w++) {
+            for (uint64_t bits = frontierBits[w]; bits != 0; bits &= bits - 1) {
+               frontier.push_back(w * 64 + lowestBit(bits));
+            }
+         }
+         bitsCurrent = false;
+      }
+      cursor.store(0, std::memory_order_relaxed);
+      bool shared = threads > 1 && frontier.size() >= kFieldParallelCells;
+      auto expand = [&](unsigned t) {
+         for (;;) {
+            size_t begin = cursor.fetch_add(kFieldChunk, std::memory_order_relaxed);
+            if (begin >= frontier.size()) { return; }
+            size_t end = std::min(begin + kFieldChunk, frontier.size());
+            for (size_t i = begin; i < end; i++) {
+               for (int offset : offsets) {
+                  int32_t cell = frontier[i] + offset;
+                  uint64_t mask = uint64_t{1} << (cell & 63);
+                  uint64_t * word = &visited[cell >> 6];
+                  if (!shared) {
+                     if ((*word & mask) != 0) { continue; }
+                     *word |= mask;
+                  } else if ((__atomic_load_n(word, __ATOMIC_RELAXED) & mask) != 0 ||
+                             (__atomic_fetch_or(word, mask, __ATOMIC_RELAXED) & mask) != 0) {
+                     continue;
+                  }
+                  distance[cell] = value;
+                  next[t].push_back(cell);
+               }
+            }
+         }
+      };
+      if (shared) { runPool(pool, expand); } else { expand(0); }
+      frontier.clear();
+      for (vector<int32_t> & cellsFound : next) {
+         frontier.insert(frontier.end(), cellsFound.begin(), cellsFound.end());
+         cellsFound.clear();
+      }
+      count = frontier.size();
+   }
+   stopPool(pool);
+}
+
+/*
+ * Same as above for a single source cell
+ */
+template <typename T>
+void distanceField(const Grid & grid, int source, vector<T> & distance, unsigned threads = 0) {
+   distanceField(grid, vector<int32_t>{source}, distance, threads);
+}
+
+/*
+ * Number of landmarks built for the ALT heuristic when none is
+ * given, and the largest number of landmarks a grid can have
+ */
+const int kLandmarkCount = 8;
+const int kMaxLandmarks = 64;
+
+/*
+ * Helper function that fills distance with the number of four-connected
+ * steps from the given cell to every cell it can reach, and -1 for the
+ * others. queue is scratch space for the breadth first search.
+ */
+void stepDistances(const Grid & grid, int from, vector<int32_t> & distance,
+                       vector<int32_t> & queue) {
+   int offsets[4];
+   neighbourOffsets(grid, offsets);
+   std::fill(distance.begin(), distance.end(), -1);
+   queue.clear();
+   distance[from] = 0;
+   queue.push_back(from);
+   for (size_t head = 0; head < queue.size(); head++) {
+      int cell = queue[head];
+      for (int offset : offsets) {
+         int next = cell + offset;
+         if (distance[next] < 0 && validOpenNodePos(next, grid)) {
+            distance[next] = distance[cell] + 1;
+            queue.push_back(next);
+         }
+      }
+   }
+}
+
+/*
+ * Selects count landmarks on the free cells of the grid and builds
+ * their distance tables into grid.landmarks. Landmarks are picked
+ * greedily, each one on the cell furthest from all landmarks picked
+ * so far, which spreads them to the edges of the map where their
+ * bounds are tightest. Cells that no landmark reaches yet are picked
+ * first, so every component of the grid gets a landmark while there
+ * are landmarks left. The tables cost count * 2 bytes per cell of
+ * the grid buffer.
+ */
+void buildLandmarks(Grid & grid, int count = kLandmarkCount) {
+   count = std::max(1, std::min(count, kMaxLandmarks));
+   size_t cells = grid.cells.size();
+   vector<uint32_t> distance;
+   // Steps from every cell to its nearest landmark, UINT32_MAX while unreached
+   vector<uint32_t> nearest(cells, UINT32_MAX);
+   Landmarks landmarks;
+   vector<uint16_t> distances(cells * count, kLandmarkFar);
+
+   // The first landmark is the cell furthest from an arbitrary free cell
+   int seed = -1;
+   for (size_t cell = 0; cell < cells && seed < 0; cell++) {
+      if (validOpenNodePos(cell, grid)) { seed = cell; }
+   }
+   if (seed < 0) { return; }
+   distanceField(grid, seed, distance);
+   int candidate = seed;
+   for (size_t cell = 0; cell < cells; cell++) {
+      if (distance[cell] != UINT32_MAX && distance[cell] > distance[candidate]) { candidate = cell; }
+   }
+
+   for (int k = 0; k < count; k++) {
+      landmarks.cells.push_back(candidate);
+      distanceField(grid, candidate, distance);
+      for (size_t cell = 0; cell < cells; cell++) {
+         if (distance[cell] < kLandmarkFar) { distances[cell * count + k] = distance[cell]; }
+         nearest[cell] = std::min(nearest[cell], distance[cell]);
+      }
+      // The next landmark goes on the free cell furthest from all of them
+      candidate = -1;
+      for (size_t cell = 0; cell < cells; cell++) {
+         if (validOpenNodePos(cell, grid) &&
+             (candidate < 0 || nearest[cell] > nearest[candidate])) { candidate = cell; }
+      }
+      if (nearest[candidate] == 0) { break; }  // Every free cell is a landmark
+   }
+   landmarks.count = landmarks.cells.size();
+   if (landmarks.count < count) {
+      // Drop the columns of the landmarks that were never placed
+      vector<uint16_t> packed(cells * landmarks.count);
+      for (size_t cell = 0; cell < cells; cell++) {
+         std::copy_n(&distances[cell * count], landmarks.count, &packed[cell * landmarks.count]);
+      }
+      distances.swap(packed);
+   }
+   landmarks.distances.adopt(std::move(distances));
+   grid.landmarks = std::move(landmarks);
+}
+
+/*
+ * Binary file format of landmark tables, stored next to its map:
+ * the header followed by the cells of the landmarks and, starting
+ * at dataOffset, the distance tables laid out as in Landmarks so
+ * that mapLandmarks can use them in place. Values are stored in
+ * native byte order.
+ */
+const char kLandmarkFileMagic[4] = {'A', 'L', 'T', 'B'};
+const uint32_t kLandmarkFileVersion = 2;
+
+// fingerprint is the gridFingerprint of the map the tables were built for
+struct LandmarkFileHeader {
+   char magic[4];
+   uint32_t version;
+   uint32_t rows;
+   uint32_t columns;
+   uint32_t stride;
+   uint32_t count;
+   uint64_t dataOffset;
+   uint64_t fingerprint;
+};
+
+/*
+ * Writes the landmark tables of the given grid to the file denoted
+ * by path. Returns false if the file could not be written.
+ */
+bool writeLandmarks(const Grid & grid, const string & path) {
+   const Landmarks & landmarks = grid.landmarks;
+   LandmarkFileHeader header{};
+   std::memcpy(header.magic, kLandmarkFileMagic, sizeof(header.magic));
+   header.version = kLandmarkFileVersion;
+   header.rows = grid.rows;
+   header.columns = grid.columns;
+   header.stride = grid.stride;
+   header.count = landmarks.count;
+   header.fingerprint = gridFingerprint(grid);
+   size_t cellsEnd = sizeof(header) + landmarks.cells.size() * sizeof(int32_t);
+   // The tables start on their own cache line
+   header.dataOffset = (cellsEnd + kRowAlignment - 1) / kRowAlignment * kRowAlignment;
+
+   std::ofstream bFile(path, std::ios::binary | std::ios::trunc);
+   auto write = [&](const void * data, size_t size) {
+      bFile.write(static_cast<const char *>(data), size);
+   };
+   const char padding[kRowAlignment] = {};
+   write(&header, sizeof(header));
+   write(landmarks.cells.data(), landmarks.cells.size() * sizeof(int32_t));
+   write(padding, header.dataOffset - cellsEnd);
+   write(landmarks.distances.begin(), landmarks.distances.size() * sizeof(uint16_t));
+   return static_cast<bool>(bFile);
+}
+
+/*
+ * Maps the landmark file denoted by path into grid.landmarks. The
+ * distance tables are used in place, so only the pages the searches
+ * touch are ever read. The file must have been written for the same
+ * map, checked by its fingerprint: tables of a map with fewer free
+ * cells overestimate distances and would make the ALT heuristic
+ * inadmissible. Returns false and leaves the grid untouched if the
+ * file is missing, invalid or built for another map.
+ */
+bool mapLandmarks(Grid & grid, const string & path) {
+   int fd = open(path.c_str(), O_RDONLY);
+   if (fd < 0) { return false; }
+   struct stat info;
+   if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(LandmarkFileHeader))) {
+      close(fd);
+      return false;
+   }
+   size_t fileSize = info.st_size;
+   void * base = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (base == MAP_FAILED) { return false; }
+   std::shared_ptr<char> mapping(static_cast<char *>(base),
+                                 [fileSize](char * p) { munmap(p, fileSize); });
+
+   LandmarkFileHeader header{};
+   std::memcpy(&header, base, sizeof(header));
+   uint64_t tableSize = uint64_t{header.count} * grid.cells.size() * sizeof(uint16_t);
+   if (std::memcmp(header.magic, kLandmarkFileMagic, sizeof(header.magic)) != 0 ||
+       header.version != kLandmarkFileVersion ||
+       header.rows != static_cast<uint32_t>(grid.rows) ||
+       header.columns != static_cast<uint32_t>(grid.columns) ||
+       header.stride != static_cast<uint32_t>(grid.stride) ||
+       header.count == 0 || header.count > kMaxLandmarks ||
+       header.dataOffset % alignof(uint16_t) != 0 ||
+       header.dataOffset < sizeof(header) + header.count * sizeof(int32_t) ||
+       header.dataOffset + tableSize > fileSize ||
+       header.fingerprint != gridFingerprint(grid)) {
+      return false;
+   }
+
+   Landmarks landmarks;
+   landmarks.count = header.count;
+   landmarks.cells.resize(header.count);
+   std::memcpy(landmarks.cells.data(), mapping.get() + sizeof(header),
+               header.count * sizeof(int32_t));
+   for (int32_t cell : landmarks.cells) {
+      if (cell < 0 || cell >= static_cast<int32_t>(grid.cells.size()) ||
+          !validOpenNodePos(cell, grid)) { return false; }
+   }
+   uint16_t * distances = reinterpret_cast<uint16_t *>(mapping.get() + header.dataOffset);
+   landmarks.distances = LayerBuffer<uint16_t>(std::shared_ptr<uint16_t>(mapping, distances),
+                                               header.count * grid.cells.size());
+   grid.landmarks = std::move(landmarks);
+   return true;
+}
+
+/*
+ * Runs searchPath with the given policies, on the terrain costs of
+ * the grid if it has a cost layer and on plain moves otherwise
+ */
+template <typename Neighbourhood, typename Heuristic, typename OpenList>
+bool terrainSearch(const Grid & grid, SearchContext<OpenList> & context,
+                   const int init[2], const int goal[2]) {
+   if (grid.costs.empty()) {
+      return searchPath<Neighbourhood, Heuristic>(grid, context, init, goal);
+   }
+   return searchPath<TerrainCost<Neighbourhood>, Heuristic>(grid, context, init, goal);
+}
+
+/*
+ * A* search on the tiled layer of the grid. Runs the same moves,
+ * terrain costs and Manhattan heuristic as searchPath does on four
+ * connected moves, so it finds a path of the same cost; only the
+ * cells and the scratch entries it touches are stored tile by tile.
+ * Falls back to searchPath when the tiled layer is not built.
+ * The path found is left as parent links in the grid buffer order
+ * like the other engines.
+ */
+template <typename OpenList>
+bool tiledSearch(const Grid & grid, SearchContext<OpenList> & context,
+                 const int init[2], const int goal[2]) {
+   const TileLayer & tiles = grid.tiles;
+   if (tiles.costs.empty()) {
+      return terrainSearch<FourConnected, ManhattanHeuristic>(grid, context, init, goal);
+   }
+   vector<CellScratch> & scratch = context.tiledScratch;
+   if (scratch.size() != tiles.costs.size()) {
+      scratch.assign(tiles.costs.size(), CellScratch{});
+      context.tiledGeneration = 0;
+   }
+   nextGeneration(context.tiledGeneration, scratch);
+   uint32_t generation = context.tiledGeneration;
+   clearOpenList(context.open);
+
+   int costScale = grid.minCost;
+   int startCell = tiledIndex(grid, init[0], init[1]);
+   int goalCell = tiledIndex(grid, goal[0], goal[1]);
+   scratch[startCell] = CellScratch{generation, 0, 0, -1};
+   int h = (abs(goal[0] - init[0]) + abs(goal[1] - init[1])) * costScale;
+   pushNode(context.open, Node{startCell, 0, h});
+   countPushed(context.stats, openListSize(context.open));
+   bool found = false;
+   while (!openListEmpty(context.open)) {
+      Node currNode = popNode(context.open);
+      CellScratch & curr = scratch[currNode.cell];
+      if (curr.closed == generation || currNode.g > curr.g) { continue; }
+      curr.closed = generation;
+      countExpanded(context.stats);
+      if (!spendExpansion(context.limits)) { return false; }
+      if (currNode.cell == goalCell) { found = true; break; }
+
+      int currX = tiledX(grid, currNode.cell);
+      int currY = tiledY(grid, currNode.cell);
+      for (int i = 0; i < 4; i++) {
+         int cell = tiledNeighbour(grid, currNode.cell, i);
+         uint8_t cost = tiles.costs[cell];
+         if (cost == kImpassable) { continue; }
+         CellScratch & next = scratch[cell];
+         if (next.closed == generation) { continue; }
+         int g = currNode.g + cost;
+         if (next.seen == generation && next.g <= g) { continue; }
+         next.seen = generation;
+         next.g = g;
+         next.parent = currNode.cell;
+         int x = currX + direction_delta[i][0];
+         int y = currY + direction_delta[i][1];
+         h = (abs(goal[0] - x) + abs(goal[1] - y)) * costScale;
+         pushNode(context.open, Node{cell, g, g + h});
+         countPushed(context.stats, openListSize(context.open));
+      }
+   }
+   if (!found) { return false; }
+
+   // Leave the path as parent links in the grid buffer like the other engines
+   beginQuery(context, grid);
+   for (int cell = goalCell; cell != -1; cell = scratch[cell].parent) {
+      int parent = scratch[cell].parent;
+      int from = (parent == -1) ? -1 : cellIndex(grid, tiledX(grid, parent), tiledY(grid, parent));
+      context.scratch[cellIndex(grid, tiledX(grid, cell), tiledY(grid, cell))] =
+         CellScratch{context.generation, context.generation, scratch[cell].g, from};
+   }
+   return true;
+}
+
+/*
+ * Search engines that can be chosen per query. The A* engines
+ * (kAStar, kOctile, kWeighted, kLandmark and kTiled) follow the terrain
+ * costs of the grid, the others treat every free cell as costing one step.
+ */
+enum class Engine {
+   kAStar,      // searchPath
+   kJumpPoint,  // jumpPointSearch
+   kHierarchical,  // hierarchicalSearch
+   kBidirectional, // bidirectionalSearch
+   kOctile,        // searchPath on eight-connected moves with octile distance
+   kWeighted,      // searchPath with a weighted Manhattan distance
+   kLandmark,      // searchPath with the ALT heuristic of the landmark tables
+   kTiled,         // tiledSearch
+};
+
+/*
+ * Weight of the heuristic used by Engine::kWeighted, as a ratio
+ */
+constexpr int kSearchWeightNumerator = 3;
+constexpr int kSearchWeightDenominator = 2;
+
+/*
+ * Helper function that dispatches a query to the given engine
+ */
+template <typename OpenList>
+bool runEngine(Engine engine, const Grid & grid, SearchContext<OpenList> & context,
+               const int init[2], const int goal[2]) {
+   switch (engine) {
+      case Engine::kJumpPoint: return jumpPointSearch(grid, context, init, goal);
+      case Engine::kHierarchical: return hierarchicalSearch(grid, context, init, goal);
+      case Engine::kBidirectional: return bidirectionalSearch(grid, context, init, goal);
+      case Engine::kOctile:
+         return terrainSearch<EightConnected, OctileHeuristic>(grid, context, init, goal);
+      case Engine::kWeighted:
+         return terrainSearch<FourConnected,
+                              WeightedHeuristic<ManhattanHeuristic, kSearchWeightNumerator,
+                                                kSearchWeightDenominator>>(grid, context, init, goal);
+      case Engine::kLandmark:
+         return terrainSearch<FourConnected, LandmarkHeuristic>(grid, context, init, goal);
+      case Engine::kTiled: return tiledSearch(grid, context, init, goal);
+      default:
+         return terrainSearch<FourConnected, ManhattanHeuristic>(grid, context, init, goal);
+   }
+}
+
+/*
+ * Runs the given search engine for a single query.
+ * Returns true if a path was found. Queries between different
+ * components are rejected up front when the labels are built.
+ * The search gives up under the limits of the context, which then
+ * marks it as aborted.
+ * The statistics of the query are left in the context.
+ */
+template <typename OpenList>
+bool findPath(Engine engine, const Grid & grid, SearchContext<OpenList> & context,
+              const int init[2], const int goal[2]) {
+   if constexpr (kCollectStats) { context.stats = SearchStats{}; }
+   resetLimits(context.limits);
+   StatsClock::time_point start = statsTime();
+   int goalCell = cellIndex(grid, goal[0], goal[1]);
+   // Start and goal in different components cannot be joined
+   bool found = sameComponent(grid, cellIndex(grid, init[0], init[1]), goalCell) &&
+                runEngine(engine, grid, context, init, goal);
+   if constexpr (kCollectStats) {
+      context.stats.searchMs = statsElapsed(start);
+      if (found) { context.stats.pathLength = context.scratch[goalCell].g; }
+   }
+   return found;
+}
+
+/*
+ * Follows the parent links recorded by the last search of the
+ * context back from the goal cell and fills the given vector
+ * with the cell indices of the path, from start to goal.
+ * Parent links that span a straight run of cells (as left by
+ * jumpPointSearch) are filled in cell by cell. A diagonal link
+ * between neighbouring cells (as left by EightConnected) is
+ * a single step.
+ * The goal cell must have been reached by that search.
+ */
+template <typename OpenList>
+void extractPath(const Grid & grid, const SearchContext<OpenList> & context,
+                 int goalCell, vector<int32_t> & path) {
+   path.clear();
+   path.push_back(goalCell);
+   for (int cell = goalCell; context.scratch[cell].parent != -1; ) {
+      int parent = context.scratch[cell].parent;
+      int diff = parent - cell;
+      if (abs(abs(diff) - grid.stride) == 1) {
+         path.push_back(parent);
+         cell = parent;
+         continue;
+      }
+      int step = (abs(diff) < grid.stride) ? (diff > 0 ? 1 : -1)
+                                           : (diff > 0 ? grid.stride : -grid.stride);
+      for (; cell != parent; cell += step) { path.push_back(cell + step); }
+   }
+   std::reverse(path.begin(), path.end());
+}
+
+/*
+ * Encodes the given path as a run-length encoded move string.
+ * Each run is a move letter followed by its repeat count, where
+ * U, L, D and R follow the order of direction_delta. A diagonal
+ * move is written as its vertical and horizontal letters.
+ * For e.g. "D3R2" is three moves down followed by two moves right
+ * and "UR4" is four moves diagonally up and right. W is a timestep
+ * spent waiting in place, as in the plans of planFleet.
+ */
+string encodeMoves(const Grid & grid, const vector<int32_t> & path) {
+   const char * const kMoveLetters[8] = {"U", "L", "D", "R", "UL", "UR", "DL", "DR"};
+   int offsets[8];
+   for (int d=0; d<8; d++) {
+      offsets[d] = EightConnected::kDelta[d][0] * grid.stride + EightConnected::kDelta[d][1];
+   }
+   string moves;
+   size_t i = 1;
+   while (i < path.size()) {
+      int step = path[i] - path[i - 1];
+      int run = 0;
+      while (i < path.size() && path[i] - path[i - 1] == step) { run++; i++; }
+      if (step == 0) { moves += "W"; }
+      for (int d=0; d<8; d++) {
+         if (offsets[d] == step) { moves += kMoveLetters[d]; }
+      }
+      moves += std::to_string(run);
+   }
+   return moves;
+}
+
+/*
+ * Incremental replanning with D* Lite.
+ *
+ * The planner searches backwards from the goal and keeps its search
+ * state (g and rhs values of every cell plus its open list) across
+ * calls. When cells flip between kEmpty and kObstacle only the cells
+ * whose distance to the goal changed are processed again, and the
+ * start may move along the path (as the robot drives) without
+ * invalidating anything. g holds the distance of a cell to the goal,
+ * rhs the one step lookahead value min(g of neighbour + 1); a cell
+ * whose two values differ is inconsistent and sits in the open list.
+ */
+struct IncrementalEntry {
+   int32_t k1;
+   int32_t k2;
+   int32_t cell;
+};
+
+struct IncrementalPlanner {
+   int startCell = -1;
+   int goalCell = -1;
+   int lastStart = -1;  // Start at the time km was last updated
+   int32_t km = 0;      // Sum of heuristic moves of the start, keeps old keys valid
+   vector<int32_t> g;
+   vector<int32_t> rhs;
+   vector<uint8_t> inOpen;
+   vector<IncrementalEntry> open;  // Min-heap, may hold outdated entries
+};
+
+/*
+ * A single cell change handed to applyCellFlips
+ */
+struct CellFlip {
+   int x;
+   int y;
+   State state;  // kEmpty or kObstacle
+};
+
+/*
+ * Helper function for ordering the open list of the planner.
+ * Works like compare, so the heap functions keep the entry with
+ * the lowest key at the front.
+ */
+bool incrementalCompare(const IncrementalEntry & a, const IncrementalEntry & b) {
+   if (a.k1 != b.k1) { return a.k1 > b.k1; }
+   return a.k2 > b.k2;
+}
+
+/*
+ * Returns the current priority key of the given cell
+ */
+IncrementalEntry incrementalKey(const IncrementalPlanner & planner, const Grid & grid, int cell) {
+   int32_t m = std::min(planner.g[cell], planner.rhs[cell]);
+   if (m >= kUnreachable) { return IncrementalEntry{kUnreachable, kUnreachable, cell}; }
+   int h = heuristic(cellX(grid, planner.startCell), cellY(grid, planner.startCell),
+                     cellX(grid, cell), cellY(grid, cell));
+   return IncrementalEntry{m + h + planner.km, m, cell};
+}
+
+/*
+ * Recomputes the rhs value of the given cell and puts it in
+ * the open list if it became inconsistent
+ */
+void updateIncrementalCell(IncrementalPlanner & planner, const Grid & grid, int cell) {
+   if (cell != planner.goalCell) {
+      int32_t best = kUnreachable;
+      if (validOpenNodePos(cell, grid)) {
+         int offsets[4];
+         neighbourOffsets(grid, offsets);
+         for (int i=0; i<4; i++) {
+            int next = cell + offsets[i];
+            if (validOpenNodePos(next, grid)) { best = std::min(best, planner.g[next] + 1); }
+         }
+      }
+      planner.rhs[cell] = std::min(best, kUnreachable);
+   }
+   if (planner.g[cell] != planner.rhs[cell]) {
+      planner.open.push_back(incrementalKey(planner, grid, cell));
+      push_heap(planner.open.begin(), planner.open.end(), incrementalCompare);
+      planner.inOpen[cell] = 1;
+   } else {
+      planner.inOpen[cell] = 0;
+   }
+}
+
+/*
+ * Drops outdated entries from the front of the open list until the
+ * front entry holds the current key of an inconsistent cell.
+ * Entries whose key grew because the start moved are pushed again.
+ * Returns false if the open list ran empty.
+ */
+bool cleanIncrementalTop(IncrementalPlanner & planner, const Grid & grid) {
+   while (!planner.open.empty()) {
+      IncrementalEntry top = planner.open.front();
+      if (planner.inOpen[top.cell]) {
+         IncrementalEntry key = incrementalKey(planner, grid, top.cell);
+         if (top.k1 == key.k1 && top.k2 == key.k2) { return true; }
+         pop_heap(planner.open.begin(), planner.open.end(), incrementalCompare);
+         planner.open.pop_back();
+         if (incrementalCompare(key, top)) {
+            planner.open.push_back(key);
+            push_heap(planner.open.begin(), planner.open.end(), incrementalCompare);
+         }
+         continue;
+      }
+      pop_heap(planner.open.begin(), planner.open.end(), incrementalCompare);
+      planner.open.pop_back();
+   }
+   return false;
+}
+
+/*
+ * Processes inconsistent cells until the distance of the start
+ * is known. Returns true if the goal can be reached from the start.
+ */
+bool computeIncrementalPath(IncrementalPlanner & planner, const Grid & grid) {
+   int offsets[4];
+   neighbourOffsets(grid, offsets);
+   int start = planner.startCell;
+   while (cleanIncrementalTop(planner, grid)) {
+      IncrementalEntry top = planner.open.front();
+      IncrementalEntry startKey = incrementalKey(planner, grid, start);
+      if (!incrementalCompare(startKey, top) && planner.rhs[start] == planner.g[start]) { break; }
+      pop_heap(planner.open.begin(), planner.open.end(), incrementalCompare);
+      planner.open.pop_back();
+
+      int cell = top.cell;
+      if (planner.g[cell] > planner.rhs[cell]) {
+         // Distance got shorter. Settle the cell and tell its neighbours
+         planner.g[cell] = planner.rhs[cell];
+         planner.inOpen[cell] = 0;
+      } else {
+         // Distance got longer. Reset the cell and recompute it with its neighbours
+         planner.g[cell] = kUnreachable;
+         updateIncrementalCell(planner, grid, cell);
+      }
+      for (int i=0; i<4; i++) { updateIncrementalCell(planner, grid, cell + offsets[i]); }
+   }
+   return planner.g[start] < kUnreachable && validOpenNodePos(start, grid);
+}
+
+/*
+ * Sets up the planner for a new start and goal on the given grid
+ * and computes the first path. Returns true if a path exists.
+ */
+bool startIncremental(IncrementalPlanner & planner, const Grid & grid,
+                      const int init[2], const int goal[2]) {
+   planner.startCell = planner.lastStart = cellIndex(grid, init[0], init[1]);
+   planner.goalCell = cellIndex(grid, goal[0], goal[1]);
+   planner.km = 0;
+   planner.g.assign(grid.cells.size(), kUnreachable);
+   planner.rhs.assign(grid.cells.size(), kUnreachable);
+   planner.inOpen.assign(grid.cells.size(), 0);
+   planner.open.clear();
+   planner.rhs[planner.goalCell] = 0;
+   updateIncrementalCell(planner, grid, planner.goalCell);
+   return computeIncrementalPath(planner, grid);
+}
+
+/*
+ * Moves the start of the planner to the given position, e.g. after
+ * the robot drove part of the path. No cell is processed again
+ * until the next flip or replan.
+ */
+void moveIncrementalStart(IncrementalPlanner & planner, const Grid & grid, const int pos[2]) {
+   planner.startCell = cellIndex(grid, pos[0], pos[1]);
+   planner.km += heuristic(cellX(grid, planner.lastStart), cellY(grid, planner.lastStart),
+                           pos[0], pos[1]);
+   planner.lastStart = planner.startCell;
+}
+
+/*
+ * Applies the given batch of cell flips to the grid and repairs
+ * the search state of the planner around them.
+ * Returns true if a path from the current start still exists.
+ */
+bool applyCellFlips(IncrementalPlanner & planner, Grid & grid,
+                    const CellFlip * flips, size_t count) {
+   int offsets[4];
+   neighbourOffsets(grid, offsets);
+   for (size_t i = 0; i < count; i++) {
+      if (!validPosOnGrid(flips[i].x, flips[i].y, grid)) { continue; }
+      int cell = cellIndex(grid, flips[i].x, flips[i].y);
+      bool blocked = (flips[i].state == State::kObstacle);
+      if (blocked == !validOpenNodePos(cell, grid)) { continue; }
+      setCellState(grid, cell, blocked ? State::kObstacle : State::kEmpty);
+      updateIncrementalCell(planner, grid, cell);
+      for (int d=0; d<4; d++) { updateIncrementalCell(planner, grid, cell + offsets[d]); }
+   }
+   return computeIncrementalPath(planner, grid);
+}
+
+/*
+ * Fills the given vector with the current path of the planner from
+ * its start to its goal by following the lowest g neighbours.
+ * The last call to the planner must have reported a path.
+ */
+void incrementalPath(const IncrementalPlanner & planner, const Grid & grid,
+                     vector<int32_t> & path) {
+   int offsets[4];
+   neighbourOffsets(grid, offsets);
+   path.assign(1, planner.startCell);
+   for (int cell = planner.startCell; cell != planner.goalCell; ) {
+      int best = -1;
+      for (int i=0; i<4; i++) {
+         int next = cell + offsets[i];
+         if (validOpenNodePos(next, grid) &&
+             (best == -1 || planner.g[next] < planner.g[best])) { best = next; }
+      }
+      cell = best;
+      path.push_back(cell);
+   }
+}
+
+/*
+ * A single start/goal pair of a batch, the engine that should
+ * answer it and its compact result.
+ * length is the number of steps of the optimum path or -1
+ * if there is no path or a position is not a free board cell.
+ */
+struct PathQuery {
+   int init[2];
+   int goal[2];
+   Engine engine;  // Value initialised to Engine::kAStar
+};
+
+struct PathResult {
+   int32_t length;
+   SearchStats stats;  // Filled in when built with PLANNER_STATS
+};
+
+/*
+ * Helper function that checks whether the given position
+ * is on the grid and is not an obstacle
+ */
+bool validQueryPos(const int pos[2], const Grid & grid) {
+   return validPosOnGrid(pos[0], pos[1], grid) &&
+          grid.cells[cellIndex(grid, pos[0], pos[1])] != State::kObstacle;
+}
+
+/*
+ * Answers the given batch of queries against one shared read-only
+ * grid using a pool of worker threads. Each worker owns a search
+ * context that it reuses for every query it picks up, and writes
+ * into results[i] for queries[i]. The results array must be
+ * preallocated by the caller with room for count entries.
+ * Workers grab queries in chunks from a shared counter so that
+ * long and short queries even out across threads.
+ * A thread count of 0 uses one worker per hardware thread.
+ */
+template <typename OpenList = BinaryHeapOpenList>
+void searchBatch(const Grid & grid, const PathQuery * queries, size_t count,
+                 PathResult * results, unsigned threads = 0) {
+   const size_t kChunkSize = 64;
+   if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+   threads = std::min<size_t>(threads, (count + kChunkSize - 1) / kChunkSize);
+   std::atomic<size_t> nextQuery{0};
+
+   auto worker = [&]() {
+      SearchContext<OpenList> context;
+      for (;;) {
+         size_t begin = nextQuery.fetch_add(kChunkSize);
+         if (begin >= count) { return; }
+         size_t end = std::min(begin + kChunkSize, count);
+         for (size_t i = begin; i < end; i++) {
+            const PathQuery & query = queries[i];
+            results[i].length = -1;
+            if (!validQueryPos(query.init, grid) || !validQueryPos(query.goal, grid)) {
+               continue;
+            }
+            if (findPath(query.engine, grid, context, query.init, query.goal)) {
+               int goalCell = cellIndex(grid, query.goal[0], query.goal[1]);
+               results[i].length = context.scratch[goalCell].g;
+            }
+            if constexpr (kCollectStats) { results[i].stats = context.stats; }
+         }
+      }
+   };
+
+   // The calling thread works as one of the workers
+   vector<std::thread> pool;
+   for (unsigned t = 1; t < threads; t++) { pool.emplace_back(worker); }
+   worker();
+   for (auto & thread : pool) { thread.join(); }
+}
+
+/*
+ * Bump allocator for the scratch memory of a single query. Memory is
+ * carved out of large blocks and handed back in bulk by rewinding to
+ * a mark, so allocating costs a pointer bump and nothing is ever freed
+ * one piece at a time. Blocks are kept across rewinds, so once a
+ * thread has seen its largest query it makes no further heap
+ * allocations.
+ *   blocks : storage, sizes[i] bytes each
+ *   block  : block that the next allocation is carved from
+ *   used   : bytes of that block in use
+ */
+const size_t kArenaBlockSize = size_t{1} << 20;
+
+struct Arena {
+   vector<std::unique_ptr<char[]>> blocks;
+   vector<size_t> sizes;
+   size_t block = 0;
+   size_t used = 0;
+};
+
+void * arenaAllocate(Arena & arena, size_t bytes, size_t align) {
+   for (;;) {
+      if (arena.block < arena.blocks.size()) {
+         uintptr_t base = reinterpret_cast<uintptr_t>(arena.blocks[arena.block].get());
+         size_t offset = ((base + arena.used + align - 1) & ~uintptr_t(align - 1)) - base;
+         if (offset + bytes <= arena.sizes[arena.block]) {
+            arena.used = offset + bytes;
+            return arena.blocks[arena.block].get() + offset;
+         }
+         if (arena.block + 1 < arena.blocks.size()) {
+            arena.block++;
+            arena.used = 0;
+            continue;
+         }
+      }
+      size_t size = std::max(kArenaBlockSize, bytes + align);
+      arena.blocks.emplace_back(new char[size]);
+      arena.sizes.push_back(size);
+      arena.block = arena.blocks.size() - 1;
+      arena.used = 0;
+   }
+}
+
+// Arena of the calling thread
+Arena & threadArena() {
+   thread_local Arena arena;
+   return arena;
+}
+
+/*
+ * Marks the arena of the calling thread on construction and rewinds
+ * it to that mark on destruction, which releases everything allocated
+ * from it in between. Scratch containers must be declared after the
+ * scope so that they are gone before it rewinds, and a container of
+ * an outer scope must not grow inside an inner one, which would hand
+ * its new storage back when the inner scope ends.
+ */
+struct ArenaScope {
+   Arena & arena;
+   size_t block;
+   size_t used;
+   ArenaScope() : arena(threadArena()), block(arena.block), used(arena.used) {}
+   ~ArenaScope() { arena.block = block; arena.used = used; }
+   ArenaScope(const ArenaScope &) = delete;
+   ArenaScope & operator=(const ArenaScope &) = delete;
+};
+
+/*
+ * Allocator of ScratchVector, taking memory from the arena of the
+ * calling thread. Freeing is a no-op, the memory comes back when the
+ * enclosing ArenaScope ends.
+ */
+template <typename T>
+struct ArenaAllocator {
+   using value_type = T;
+   ArenaAllocator() = default;
+   template <typename U> ArenaAllocator(const ArenaAllocator<U> &) {}
+   T * allocate(size_t count) {
+      return static_cast<T *>(arenaAllocate(threadArena(), count * sizeof(T), alignof(T)));
+   }
+   void deallocate(T *, size_t) {}
+   template <typename U> bool operator==(const ArenaAllocator<U> &) const { return true; }
+   template <typename U> bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+/*
+ * Container for the per-query scratch data that does not live in a
+ * search context. Built with -DPLANNER_ARENA=1 it allocates from the
+ * arena of the thread inside an ArenaScope, otherwise it is a plain
+ * vector on the heap, so the two can be compared.
+ */
+#ifndef PLANNER_ARENA
+#define PLANNER_ARENA 0
+#endif
+#if PLANNER_ARENA
+template <typename T>
+using ScratchVector = vector<T, ArenaAllocator<T>>;
+#else
+template <typename T>
+using ScratchVector = vector<T>;
+#endif
+
+/*
+ * Heuristic policy that estimates nothing, which turns searchPath
+ * and its neighbour expansion into Dijkstra's algorithm
+ */
+struct ZeroHeuristic {
+   template <typename Neighbourhood>
+   static int estimate(const Grid &, int, int, int, int) { return 0; }
+};
+
+/*
+ * Runs a single Dijkstra search from init that settles the given
+ * target cells in order of their distance and stops once wanted of
+ * them are settled. distances[i] gets the cost of the optimum path
+ * to targets[i], or -1 if it was not settled. Targets that are
+ * obstacles or lie in another component are never searched for.
+ * The parent links of the search are left in the context, so the
+ * path to every settled target can be read with extractPath, and
+ * so are its statistics.
+ * Returns the number of distinct target cells settled.
+ */
+template <typename Neighbourhood, typename OpenList, typename Targets, typename Distances>
+size_t searchTargets(const Grid & grid, SearchContext<OpenList> & context, const int init[2],
+                     const Targets & targets, Distances & distances, size_t wanted) {
+   if constexpr (kCollectStats) { context.stats = SearchStats{}; }
+   StatsClock::time_point start = statsTime();
+   int startCell = cellIndex(grid, init[0], init[1]);
+   // Sized before the scope opens, as distances may come from the arena of the caller
+   distances.resize(targets.size());
+   ArenaScope scope;
+   // Sorted distinct targets the search can settle
+   ScratchVector<int32_t> open;
+   for (int32_t cell : targets) {
+      if (validOpenNodePos(cell, grid) && sameComponent(grid, startCell, cell)) {
+         open.push_back(cell);
+      }
+   }
+   std::sort(open.begin(), open.end());
+   open.erase(std::unique(open.begin(), open.end()), open.end());
+   wanted = std::min(wanted, open.size());
+
+   beginQuery(context, grid);
+   size_t settled = 0;
+   if (wanted > 0) { addToOpenNodes(Node{startCell, 0, 0}, -1, context); }
+   while (settled < wanted && !openListEmpty(context.open)) {
+      Node currNode = popNode(context.open);
+      CellScratch & scratch = context.scratch[currNode.cell];
+      if (scratch.closed == context.generation || currNode.g > scratch.g) { continue; }
+      scratch.closed = context.generation;
+      countExpanded(context.stats);
+      if (std::binary_search(open.begin(), open.end(), currNode.cell)) { settled++; }
+      expandNeighbours<Neighbourhood, ZeroHeuristic>(currNode, init, grid, context);
+   }
+
+   for (size_t i = 0; i < targets.size(); i++) {
+      const CellScratch & scratch = context.scratch[targets[i]];
+      bool reached = validOpenNodePos(targets[i], grid) && scratch.closed == context.generation;
+      distances[i] = reached ? scratch.g : -1;
+   }
+   if constexpr (kCollectStats) { context.stats.searchMs = statsElapsed(start); }
+   return settled;
+}
+
+/*
+ * One-to-many query: finds the cost of the optimum path from init
+ * to every one of the given target cells in a single search, on the
+ * terrain costs of the grid if it has a cost layer. distances[i] gets
+ * the cost to targets[i], or -1 if there is no path. Returns the
+ * number of distinct target cells reached.
+ */
+template <typename OpenList, typename Targets, typename Distances>
+size_t findDistances(const Grid & grid, SearchContext<OpenList> & context, const int init[2],
+                     const Targets & targets, Distances & distances) {
+   size_t wanted = targets.size();
+   if (grid.costs.empty()) {
+      return searchTargets<FourConnected>(grid, context, init, targets, distances, wanted);
+   }
+   return searchTargets<TerrainCost<FourConnected>>(grid, context, init, targets, distances, wanted);
+}
+
+/*
+ * Nearest-of-N query: searches from init until the first of the
+ * given target cells is reached. Returns the index of the nearest
+ * target, or -1 if none can be reached. Its cost is left in
+ * distance and its path can be read from the context with extractPath.
+ */
+template <typename OpenList, typename Targets>
+int findNearest(const Grid & grid, SearchContext<OpenList> & context, const int init[2],
+                const Targets & targets, int32_t & distance) {
+   ArenaScope scope;
+   ScratchVector<int32_t> distances;
+   if (grid.costs.empty()) {
+      searchTargets<FourConnected>(grid, context, init, targets, distances, 1);
+   } else {
+      searchTargets<TerrainCost<FourConnected>>(grid, context, init, targets, distances, 1);
+   }
+   int nearest = -1;
+   distance = -1;
+   for (size_t i = 0; i < distances.size(); i++) {
+      if (distances[i] >= 0 && (nearest < 0 || distances[i] < distance)) {
+         nearest = i;
+         distance = distances[i];
+      }
+   }
+   return nearest;
+}
+
+/*
+ * Compact hash map from (cell, timestep) pairs to 32-bit values for
+ * the space-time search of a fleet. Keys are packed into a single
+ * 64-bit word and stored with open addressing and linear probing, so
+ * a lookup usually touches a single cache line. The table doubles
+ * once it is half full.
+ */
+const uint64_t kSpaceTimeEmpty = ~uint64_t{0};
+
+struct SpaceTimeTable {
+   vector<uint64_t> keys;
+   vector<int32_t> values;
+   size_t count = 0;
+};
+
+uint64_t spaceTimeKey(int cell, int time) {
+   return (uint64_t(uint32_t(time)) << 32) | uint32_t(cell);
+}
+
+size_t spaceTimeSlot(const SpaceTimeTable & table, uint64_t key) {
+   return size_t((key * 0x9E3779B97F4A7C15ull) >> 32) & (table.keys.size() - 1);
+}
+
+/*
+ * Returns the value stored for the given key, or null if the table
+ * does not hold it
+ */
+const int32_t * findSpaceTime(const SpaceTimeTable & table, uint64_t key) {
+   if (table.count == 0) { return nullptr; }
+   for (size_t slot = spaceTimeSlot(table, key); ; slot = (slot + 1) & (table.keys.size() - 1)) {
+      if (table.keys[slot] == key) { return &table.values[slot]; }
+      if (table.keys[slot] == kSpaceTimeEmpty) { return nullptr; }
+   }
+}
+
+/*
+ * Adds the given key with the given value unless the table already
+ * holds it. Returns the value stored for the key, with added telling
+ * whether it was added just now.
+ */
+int32_t & insertSpaceTime(SpaceTimeTable & table, uint64_t key, int32_t value, bool & added) {
+   if (2 * (table.count + 1) > table.keys.size()) {
+      SpaceTimeTable grown;
+      grown.keys.assign(std::max<size_t>(64, 2 * table.keys.size()), kSpaceTimeEmpty);
+      grown.values.resize(grown.keys.size());
+      for (size_t i = 0; i < table.keys.size(); i++) {
+         if (table.keys[i] == kSpaceTimeEmpty) { continue; }
+         size_t slot = spaceTimeSlot(grown, table.keys[i]);
+         while (grown.keys[slot] != kSpaceTimeEmpty) { slot = (slot + 1) & (grown.keys.size() - 1); }
+         grown.keys[slot] = table.keys[i];
+         grown.values[slot] = table.values[i];
+      }
+      grown.count = table.count;
+      table = std::move(grown);
+   }
+   size_t slot = spaceTimeSlot(table, key);
+   while (table.keys[slot] != kSpaceTimeEmpty && table.keys[slot] != key) {
+      slot = (slot + 1) & (table.keys.size() - 1);
+   }
+   added = (table.keys[slot] == kSpaceTimeEmpty);
+   if (added) {
+      table.keys[slot] = key;
+      table.values[slot] = value;
+      table.count++;
+   }
+   return table.values[slot];
+}
+
+/*
+ * Empties the table. Its capacity is kept for the next use unless
+ * it is far larger than what was used, so that one huge search does
+ * not slow down clearing the table for all later ones.
+ */
+void clearSpaceTime(SpaceTimeTable & table) {
+   if (table.keys.size() > 8 * std::max<size_t>(table.count, 4096)) {
+      table = SpaceTimeTable{};
+      return;
+   }
+   std::fill(table.keys.begin(), table.keys.end(), kSpaceTimeEmpty);
+   table.count = 0;
+}
+
+/*
+ * Space-time reservations of the agents of a fleet planned so far.
+ * Positions are keyed by spaceTimeKey, plain cells by
+ * spaceTimeKey(cell, 0).
+ *   reserved : agent that occupies a cell at a timestep
+ *   parked   : timestep from which an agent stays on a cell for
+ *              good, once it has arrived at its goal
+ *   latest   : last timestep at which a cell is reserved
+ *   lastTime : last timestep of any reservation
+ */
+struct ReservationTable {
+   SpaceTimeTable reserved;
+   SpaceTimeTable parked;
+   SpaceTimeTable latest;
+   int32_t lastTime = 0;
+};
+
+/*
+ * Returns true if the given cell is taken by an agent at the given
+ * timestep, either moving through it or parked on it
+ */
+bool cellReserved(const ReservationTable & table, int cell, int time) {
+   if (findSpaceTime(table.reserved, spaceTimeKey(cell, time)) != nullptr) { return true; }
+   const int32_t * parked = findSpaceTime(table.parked, spaceTimeKey(cell, 0));
+   return parked != nullptr && *parked <= time;
+}
+
+/*
+ * Returns true if an agent cannot move from cell from at the given
+ * timestep onto cell to, because to is taken at the next timestep or
+ * because another agent makes the opposite move at the same time
+ */
+bool moveConflicts(const ReservationTable & table, int from, int to, int time) {
+   if (cellReserved(table, to, time + 1)) { return true; }
+   if (from == to) { return false; }
+   const int32_t * there = findSpaceTime(table.reserved, spaceTimeKey(to, time));
+   const int32_t * back = findSpaceTime(table.reserved, spaceTimeKey(from, time + 1));
+   return there != nullptr && back != nullptr && *there == *back;
+}
+
+/*
+ * Reserves the given path of an agent in the table. Entry t of the
+ * path is the cell of the agent at timestep t. The agent stays
+ * parked on the last cell of its path afterwards.
+ */
+void reservePath(ReservationTable & table, const vector<int32_t> & path, int agent) {
+   bool added = false;
+   for (size_t time = 0; time < path.size(); time++) {
+      insertSpaceTime(table.reserved, spaceTimeKey(path[time], time), agent, added);
+      int32_t & latest = insertSpaceTime(table.latest, spaceTimeKey(path[time], 0), time, added);
+      latest = std::max<int32_t>(latest, time);
+   }
+   insertSpaceTime(table.parked, spaceTimeKey(path.back(), 0), path.size() - 1, added);
+   table.lastTime = std::max<int32_t>(table.lastTime, path.size() - 1);
+}
+
+/*
+ * Working state of spaceTimeSearch, reused across the agents of a fleet.
+ *   nodes    : every space-time position pushed so far, with the node
+ *              it was reached from
+ *   visited  : node of every (cell, timestep) pair pushed so far
+ *   distance : steps from every cell to the goal of the agent, ignoring
+ *              the other agents, which is the heuristic of the search
+ */
+struct SpaceTimeNode {
+   int32_t cell;
+   int32_t time;
+   int32_t parent;
+};
+
+struct SpaceTimeContext {
+   vector<SpaceTimeNode> nodes;
+   SpaceTimeTable visited;
+   BinaryHeapOpenList open;
+   vector<int32_t> distance;
+   vector<int32_t> queue;
+   SearchStats stats;
+};
+
+/*
+ * Space-time A* for one agent of a fleet. Every step the agent either
+ * moves to one of its four neighbours or waits in place, each taking
+ * one timestep, and no step may conflict with the reservations of the
+ * agents planned before it. The agent may only stop on its goal once
+ * no other agent passes through that cell later on. Every position has
+ * g equal to its timestep, so a position is never pushed twice. The
+ * heuristic is the exact distance to the goal on the empty grid, from
+ * a breadth first search of the goal, or the time left until the goal
+ * is free for good if that is longer. The search gives up at a time
+ * horizon: the last reserved timestep plus twice the shortest path
+ * length plus the rows and columns of the board, which leaves room
+ * for waiting out every reservation and for a long detour.
+ * Fills path with the cell of the agent at every timestep and
+ * returns true if a plan was found.
+ */
+bool spaceTimeSearch(const Grid & grid, const ReservationTable & table, SpaceTimeContext & context,
+                     const int init[2], const int goal[2], vector<int32_t> & path) {
+   const int kWait = 4;
+   int startCell = cellIndex(grid, init[0], init[1]);
+   int goalCell = cellIndex(grid, goal[0], goal[1]);
+   path.clear();
+   if (context.distance.size() != grid.cells.size()) { context.distance.resize(grid.cells.size()); }
+   stepDistances(grid, goalCell, context.distance, context.queue);
+   if (context.distance[startCell] < 0 || cellReserved(table, startCell, 0)) { return false; }
+   int horizon = table.lastTime + 2 * context.distance[startCell] + grid.rows + grid.columns;
+
+   context.nodes.clear();
+   clearSpaceTime(context.visited);
+   clearOpenList(context.open);
+   bool added = false;
+   context.nodes.push_back(SpaceTimeNode{startCell, 0, -1});
+   insertSpaceTime(context.visited, spaceTimeKey(startCell, 0), 0, added);
+   const int32_t * goalLatest = findSpaceTime(table.latest, spaceTimeKey(goalCell, 0));
+   int arrival = goalLatest ? *goalLatest + 1 : 0;  // Earliest timestep to stay on the goal
+   pushNode(context.open, Node{0, 0, std::max(context.distance[startCell], arrival)});
+   countPushed(context.stats, openListSize(context.open));
+
+   while (!openListEmpty(context.open)) {
+      Node currNode = popNode(context.open);
+      SpaceTimeNode current = context.nodes[currNode.cell];
+      countExpanded(context.stats);
+      if (current.cell == goalCell && current.time >= arrival) {
+         for (int node = currNode.cell; node != -1; node = context.nodes[node].parent) {
+            path.push_back(context.nodes[node].cell);
+         }
+         std::reverse(path.begin(), path.end());
+         return true;
+      }
+      if (current.time >= horizon) { continue; }
+      for (int i = 0; i <= kWait; i++) {
+         int cell = current.cell;
+         if (i < kWait) { cell += direction_delta[i][0] * grid.stride + direction_delta[i][1]; }
+         int h = context.distance[cell];
+         if (h < 0 || moveConflicts(table, current.cell, cell, current.time)) { continue; }
+         int time = current.time + 1;
+         insertSpaceTime(context.visited, spaceTimeKey(cell, time), context.nodes.size(), added);
+         if (!added) { continue; }
+         pushNode(context.open, Node{int32_t(context.nodes.size()), time, std::max(time + h, arrival)});
+         context.nodes.push_back(SpaceTimeNode{cell, time, currNode.cell});
+         countPushed(context.stats, openListSize(context.open));
+      }
+   }
+   return false;
+}
+
+/*
+ * Prioritized planning of a fleet. The agents are planned one after
+ * the other in the given order, each with spaceTimeSearch against the
+ * reservations of the ones before it, so that no two agents are ever
+ * on the same cell or swap cells in the same timestep. paths[i] gets
+ * the cell of agent i at every timestep, or stays empty if no plan
+ * was found for it, in which case later agents do not avoid it.
+ * The statistics of all searches add up in context.
+ * Returns the number of agents planned.
+ */
+size_t planFleet(const Grid & grid, SpaceTimeContext & context, const vector<PathQuery> & agents,
+                 vector<vector<int32_t>> & paths) {
+   ReservationTable table;
+   context.stats = SearchStats{};
+   paths.assign(agents.size(), vector<int32_t>{});
+   size_t planned = 0;
+   for (size_t i = 0; i < agents.size(); i++) {
+      const PathQuery & agent = agents[i];
+      if (!validQueryPos(agent.init, grid) || !validQueryPos(agent.goal, grid)) { continue; }
+      if (spaceTimeSearch(grid, table, context, agent.init, agent.goal, paths[i])) {
+         reservePath(table, paths[i], i);
+         planned++;
+      }
+   }
+   return planned;
+}
+
+/*
+ * Drops the cells of the given path that lie inside a straight or
+ * diagonal run, which leaves only its corners. expandPath restores
+ * the full path from them.
+ */
+template <typename Corners>
+void compressPath(const vector<int32_t> & path, Corners & corners) {
+   corners.clear();
+   for (size_t i = 0; i < path.size(); i++) {
+      if (i == 0 || i + 1 == path.size() ||
+          path[i] - path[i - 1] != path[i + 1] - path[i]) { corners.push_back(path[i]); }
+   }
+}
+
+template <typename Corners>
+void expandPath(const Grid & grid, const Corners & corners, vector<int32_t> & path) {
+   path.clear();
+   for (size_t i = 0; i < corners.size(); i++) {
+      if (i == 0) { path.push_back(corners[0]); continue; }
+      int dx = cellX(grid, corners[i]) - cellX(grid, corners[i - 1]);
+      int dy = cellY(grid, corners[i]) - cellY(grid, corners[i - 1]);
+      int step = ((dx > 0) - (dx < 0)) * grid.stride + ((dy > 0) - (dy < 0));
+      for (int cell = corners[i - 1]; cell != corners[i]; ) {
+         cell += step;
+         path.push_back(cell);
+      }
+   }
+}
+
+/*
+ * Returns true if the straight line between the centres of the two
+ * given cells only crosses free cells. Walks the line with
+ * Bresenham's algorithm, on the occupancy layer when it is built.
+ * A step along both axes also needs both cells beside it free, so
+ * that the line never cuts the corner of an obstacle.
+ */
+bool lineOfSight(const Grid & grid, int from, int to) {
+   bool packed = !grid.occupancy.words.empty();
+   auto open = [&](int cell) {
+      return packed ? validOpenNodePos(cell, grid.occupancy) : validOpenNodePos(cell, grid);
+   };
+   int dx = cellX(grid, to) - cellX(grid, from);
+   int dy = cellY(grid, to) - cellY(grid, from);
+   int stepX = (dx < 0) ? -grid.stride : grid.stride;
+   int stepY = (dy < 0) ? -1 : 1;
+   dx = abs(dx); dy = abs(dy);
+   int error = dx - dy;
+   for (int cell = from; cell != to; ) {
+      bool moveX = 2 * error > -dy;
+      bool moveY = 2 * error < dx;
+      if (moveX && moveY && !(open(cell + stepX) && open(cell + stepY))) { return false; }
+      if (moveX) { error -= dy; cell += stepX; }
+      if (moveY) { error += dx; cell += stepY; }
+      if (!open(cell)) { return false; }
+   }
+   return true;
+}
+
+/*
+ * String pulling: reduces the given path to the waypoints of an any
+ * angle path a controller can drive in straight lines. Waypoints are
+ * cells of the path, the first and the last included, and each one
+ * has line of sight to the next. From every waypoint the next one is
+ * the furthest corner of the path that can still be seen, found by
+ * checking the corners back from the last one. A corner hidden behind
+ * an obstacle does not hide the ones after it, as the path can come
+ * back into view once it has turned around the obstacle. A path of n
+ * corners costs O(n) line checks per waypoint, still small next to
+ * the search. The result is never longer than the corners of
+ * compressPath.
+ */
+void smoothPath(const Grid & grid, const vector<int32_t> & path, vector<int32_t> & waypoints) {
+   // Pulled in place over the corners, which come in order
+   compressPath(path, waypoints);
+   if (waypoints.size() <= 2) { return; }
+   size_t last = waypoints.size() - 1;
+   size_t kept = 0;
+   for (size_t anchor = 0; anchor < last; ) {
+      // The next corner is always visible along a straight or diagonal run
+      size_t seen = last;
+      while (seen > anchor + 1 && !lineOfSight(grid, waypoints[anchor], waypoints[seen])) {
+         seen--;
+      }
+      waypoints[++kept] = waypoints[seen];
+      anchor = seen;
+   }
+   waypoints.resize(kept + 1);
+}
+
+/*
+ * Thread-safe LRU cache of found paths, shared by any number of
+ * planning threads. Entries are keyed by start cell, goal cell and
+ * engine, and remember the version of the grid they were planned
+ * on. setCellState bumps the version, so every entry planned before
+ * a change is dropped on its next lookup. The cache is split into
+ * shards with a lock each, so that threads rarely wait for each
+ * other. Each shard keeps its entries in a list from most to least
+ * recently used, with a hash index into it.
+ */
+struct PathCacheKey {
+   int32_t start;
+   int32_t goal;
+   Engine engine;
+   bool operator==(const PathCacheKey & other) const {
+      return start == other.start && goal == other.goal && engine == other.engine;
+   }
+};
+
+struct PathCacheKeyHash {
+   size_t operator()(const PathCacheKey & key) const {
+      uint64_t packed = (uint64_t(uint32_t(key.start)) << 32) ^ uint32_t(key.goal) ^
+                        (uint64_t(key.engine) << 29);
+      return std::hash<uint64_t>()(packed * 0x9E3779B97F4A7C15ull);
+   }
+};
+
+struct PathCacheEntry {
+   PathCacheKey key;
+   uint64_t version;
+   int32_t length;
+   vector<int32_t> corners;   // Path compressed by compressPath
+};
+
+struct PathCacheShard {
+   std::mutex lock;
+   std::list<PathCacheEntry> entries;
+   std::unordered_map<PathCacheKey, std::list<PathCacheEntry>::iterator, PathCacheKeyHash> index;
+};
+
+/*
+ * Counters of the cache
+ *   hits        : lookups answered by an entry of the same query
+ *   reverseHits : lookups answered by reversing the path of the
+ *                 reverse query
+ *   misses      : lookups that found no usable entry
+ *   stale       : entries dropped as the grid changed after them
+ *   evictions   : entries dropped to make room for new ones
+ */
+struct PathCacheStats {
+   uint64_t hits = 0;
+   uint64_t reverseHits = 0;
+   uint64_t misses = 0;
+   uint64_t stale = 0;
+   uint64_t evictions = 0;
+};
+
+struct PathCache {
+   size_t shardCapacity = 0;
+   vector<PathCacheShard> shards;
+   std::atomic<uint64_t> hits{0};
+   std::atomic<uint64_t> reverseHits{0};
+   std::atomic<uint64_t> misses{0};
+   std::atomic<uint64_t> stale{0};
+   std::atomic<uint64_t> evictions{0};
+};
+
+// Default number of shards of a path cache
+const unsigned kCacheShards = 16;
+
+/*
+ * Sets up the given cache to hold up to capacity paths spread over
+ * the given number of shards. Any cached paths are dropped.
+ */
+void initPathCache(PathCache & cache, size_t capacity, unsigned shards = kCacheShards) {
+   shards = std::max<size_t>(1, std::min<size_t>(shards, capacity));
+   cache.shardCapacity = std::max<size_t>(1, (capacity + shards - 1) / shards);
+   cache.shards = vector<PathCacheShard>(shards);
+}
+
+PathCacheStats pathCacheStats(const PathCache & cache) {
+   PathCacheStats stats;
+   stats.hits = cache.hits; stats.reverseHits = cache.reverseHits;
+   stats.misses = cache.misses; stats.stale = cache.stale; stats.evictions = cache.evictions;
+   return stats;
+}
+
+/*
+ * Helper function that looks up the given key in its shard.
+ * On a hit the cached corners and length are copied out and the
+ * entry becomes the most recently used one.
+ */
+bool findCacheEntry(PathCache & cache, const PathCacheKey & key, uint64_t version,
+                    ScratchVector<int32_t> & corners, int32_t & length) {
+   PathCacheShard & shard = cache.shards[PathCacheKeyHash()(key) % cache.shards.size()];
+   std::lock_guard<std::mutex> guard(shard.lock);
+   auto found = shard.index.find(key);
+   if (found == shard.index.end()) { return false; }
+   auto entry = found->second;
+   if (entry->version != version) {
+      shard.index.erase(found);
+      shard.entries.erase(entry);
+      cache.stale++;
+      return false;
+   }
+   shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+   corners.assign(entry->corners.begin(), entry->corners.end());
+   length = entry->length;
+   return true;
+}
+
+/*
+ * Looks up the path of the given query in the cache and fills in
+ * path and length on a hit. A path cached for the reverse query is
+ * reversed when the grid has no terrain costs, as moves then cost
+ * the same both ways. Returns false on a miss.
+ */
+bool cacheLookup(PathCache & cache, const Grid & grid, Engine engine, int startCell,
+                 int goalCell, vector<int32_t> & path, int32_t & length) {
+   ArenaScope scope;
+   ScratchVector<int32_t> corners;
+   if (findCacheEntry(cache, PathCacheKey{startCell, goalCell, engine}, grid.version,
+                      corners, length)) {
+      cache.hits++;
+      expandPath(grid, corners, path);
+      return true;
+   }
+   if (grid.costs.empty() &&
+       findCacheEntry(cache, PathCacheKey{goalCell, startCell, engine}, grid.version,
+                      corners, length)) {
+      cache.reverseHits++;
+      std::reverse(corners.begin(), corners.end());
+      expandPath(grid, corners, path);
+      return true;
+   }
+   cache.misses++;
+   return false;
+}
+
+/*
+ * Stores the given path of a query in the cache, evicting the least
+ * recently used path of the shard when it is full. The entry and the
+ * index node of an evicted path are reused for the new one, so a full
+ * cache allocates no list or index node and never rehashes. The corner
+ * storage of the entry is reused too; it only grows when the new path
+ * has more corners than the entry held before.
+ */
+void cacheStore(PathCache & cache, const Grid & grid, Engine engine,
+                const vector<int32_t> & path, int32_t length) {
+   PathCacheKey key{path.front(), path.back(), engine};
+   ArenaScope scope;
+   ScratchVector<int32_t> corners;
+   compressPath(path, corners);
+   PathCacheShard & shard = cache.shards[PathCacheKeyHash()(key) % cache.shards.size()];
+   std::lock_guard<std::mutex> guard(shard.lock);
+   auto found = shard.index.find(key);
+   std::list<PathCacheEntry>::iterator entry;
+   if (found != shard.index.end()) {
+      entry = found->second;
+   } else if (shard.entries.size() >= cache.shardCapacity) {
+      entry = std::prev(shard.entries.end());
+      auto node = shard.index.extract(entry->key);
+      node.key() = key;
+      shard.index.insert(std::move(node));
+      cache.evictions++;
+   } else {
+      entry = shard.entries.emplace(shard.entries.begin());
+      shard.index.emplace(key, entry);
+   }
+   entry->key = key;
+   entry->version = grid.version;
+   entry->length = length;
+   entry->corners.assign(corners.begin(), corners.end());
+   shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+}
+
+/*
+ * Answers a single query through the cache: a hit is returned
+ * straight away, a miss is searched with findPath and stored.
+ * Fills in path and length and returns true if a path was found.
+ * The statistics of a hit show no search work.
+ */
+template <typename OpenList>
+bool cachedFindPath(PathCache & cache, Engine engine, const Grid & grid,
+                    SearchContext<OpenList> & context, const int init[2], const int goal[2],
+                    vector<int32_t> & path, int32_t & length) {
+   int startCell = cellIndex(grid, init[0], init[1]);
+   int goalCell = cellIndex(grid, goal[0], goal[1]);
+   if (cacheLookup(cache, grid, engine, startCell, goalCell, path, length)) {
+      if constexpr (kCollectStats) {
+         context.stats = SearchStats{};
+         context.stats.pathLength = length;
+      }
+      return true;
+   }
+   if (!findPath(engine, grid, context, init, goal)) { return false; }
+   extractPath(grid, context, goalCell, path);
+   length = context.scratch[goalCell].g;
+   cacheStore(cache, grid, engine, path, length);
+   return true;
+}
+
+/*
+ * Bounded multi-producer multi-consumer queue. pushQueue fails when
+ * the queue is full unless asked to wait for room, and always fails
+ * once the queue is closed. popQueue waits for an item and fails once
+ * the queue is closed and empty, so the items queued before closing
+ * are still handed out.
+ *   capacity : largest number of queued items
+ *   peak     : largest number of items queued at once
+ */
+template <typename T>
+struct BoundedQueue {
+   std::mutex mutex;
+   std::condition_variable notEmpty;
+   std::condition_variable notFull;
+   std::deque<T> items;
+   size_t capacity = 0;
+   size_t peak = 0;
+   bool closed = false;
+};
+
+/*
+ * Moves the given item into the queue. Returns false and leaves the
+ * item alone if the queue is closed, or full while wait is false.
+ * waited is set if the call had to wait for room.
+ */
+template <typename T>
+bool pushQueue(BoundedQueue<T> & queue, T & item, bool wait, bool & waited) {
+   std::unique_lock<std::mutex> lock(queue.mutex);
+   waited = false;
+   if (!queue.closed && queue.items.size() >= queue.capacity) {
+      if (!wait) { return false; }
+      waited = true;
+      queue.notFull.wait(lock, [&] { return queue.closed || queue.items.size() < queue.capacity; });
+   }
+   if (queue.closed) { return false; }
+   queue.items.push_back(std::move(item));
+   queue.peak = std::max(queue.peak, queue.items.size());
+   lock.unlock();
+   queue.notEmpty.notify_one();
+   return true;
+}
+
+template <typename T>
+bool popQueue(BoundedQueue<T> & queue, T & item) {
+   std::unique_lock<std::mutex> lock(queue.mutex);
+   queue.notEmpty.wait(lock, [&] { return queue.closed || !queue.items.empty(); });
+   if (queue.items.empty()) { return false; }
+   item = std::move(queue.items.front());
+   queue.items.pop_front();
+   lock.unlock();
+   queue.notFull.notify_one();
+   return true;
+}
+
+template <typename T>
+void closeQueue(BoundedQueue<T> & queue) {
+   {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.closed = true;
+   }
+   queue.notEmpty.notify_all();
+   queue.notFull.notify_all();
+}
+
+/*
+ * A query for the planning service.
+ *   engine     : engine that answers the query
+ *   budget     : largest number of nodes the search may expand,
+ *                0 for no limit
+ *   deadlineMs : time from submitting within which the query has to
+ *                be answered, 0 for no deadline. A query still
+ *                waiting in the queue at its deadline is never run.
+ *   wantPath   : whether the result should carry the path cells
+ */
+struct PlanRequest {
+   int init[2];
+   int goal[2];
+   Engine engine = Engine::kAStar;
+   uint64_t budget = 0;
+   double deadlineMs = 0;
+   bool wantPath = false;
+};
+
 /*
- * Helper Function that parses a string 
- * and returns a vector<State> object.
+ * Outcome of a query of the planning service
+ *   kFound     : a path was found
+ *   kNoPath    : there is no path or a position is not a free board cell
+ *   kAborted   : the search ran out of its budget or deadline
+ *   kExpired   : the deadline passed before the query left the queue
+ *   kCancelled : cancelPlan was called before the query was answered
+ *   kRejected  : the queue was full or the service stopped
  */
-vector<State> parseLine(string line) {
-   istringstream sLine(line);
-   vector<State> row{};
-   int n; char c;
+enum class PlanStatus {
+   kFound,
+   kNoPath,
+   kAborted,
+   kExpired,
+   kCancelled,
+   kRejected,
+};
 
-   if (sLine) {
-      while(sLine >> n >> c && c == ',') {
-         (n != 0) ? row.push_back(State::kObstacle)
-                  : row.push_back(State::kEmpty);
-      }
+const int kPlanStatusCount = 6;
+const char * const kPlanStatusNames[kPlanStatusCount] = {"found", "nopath", "aborted",
+                                                         "expired", "cancelled", "rejected"};
+
+/*
+ * Answer of the planning service. length is the path cost or -1,
+ * path the cells of the path when asked for, expanded the number of
+ * nodes the search expanded, waitMs the time spent in the queue and
+ * searchMs the time spent searching.
+ */
+struct PlanResult {
+   PlanStatus status = PlanStatus::kRejected;
+   int32_t length = -1;
+   vector<int32_t> path;
+   uint64_t expanded = 0;
+   double waitMs = 0;
+   double searchMs = 0;
+};
+
+/*
+ * Handle of a submitted query. result becomes ready once the query is
+ * answered, right away if it was not accepted. cancel is shared with
+ * the worker that runs the query; see cancelPlan.
+ */
+struct PlanTicket {
+   bool accepted = false;
+   std::future<PlanResult> result;
+   std::shared_ptr<std::atomic<bool>> cancel;
+};
+
+// Queued query along with the state needed to answer it
+struct PlanJob {
+   PlanRequest request;
+   std::shared_ptr<std::atomic<bool>> cancel;
+   std::promise<PlanResult> promise;
+   std::function<void(const PlanResult &)> done;
+   StatsClock::time_point queued;
+};
+
+/*
+ * Planning service: queries submitted from any thread go through a
+ * bounded queue to a fixed set of worker threads, each with its own
+ * search context, that answer them on a shared read-only grid. The
+ * grid must not change while the service runs. Every query can carry
+ * an expansion budget and a deadline, so that long searches give way
+ * to short ones instead of holding up a worker. The counters are the
+ * backpressure metrics read by serviceMetrics.
+ */
+const size_t kServiceQueueSize = 256;
+
+struct PlanningService {
+   const Grid * grid = nullptr;
+   BoundedQueue<PlanJob> queue;
+   vector<std::thread> workers;
+   std::atomic<uint64_t> submitted{0};
+   std::atomic<uint64_t> stalled{0};   // Submits that had to wait for room
+   std::atomic<uint64_t> outcomes[kPlanStatusCount] = {};
+   std::atomic<uint64_t> waitMicros{0};
+   std::atomic<uint64_t> maxWaitMicros{0};
+};
+
+/*
+ * Snapshot of the counters of a planning service
+ *   submitted : queries accepted into the queue
+ *   stalled   : accepted queries whose submit had to wait for room
+ *   outcomes  : answered and rejected queries by status
+ *   depth     : queries waiting in the queue
+ *   peakDepth : most queries waiting at once
+ *   meanWaitMs, maxWaitMs : time answered queries spent in the queue
+ */
+struct ServiceMetrics {
+   uint64_t submitted = 0;
+   uint64_t stalled = 0;
+   uint64_t outcomes[kPlanStatusCount] = {};
+   size_t depth = 0;
+   size_t capacity = 0;
+   size_t peakDepth = 0;
+   double meanWaitMs = 0;
+   double maxWaitMs = 0;
+};
+
+/*
+ * Answers one job on the context of the calling worker
+ */
+PlanResult answerPlan(const Grid & grid, SearchContext<> & context, PlanJob & job) {
+   const PlanRequest & request = job.request;
+   PlanResult result;
+   StatsClock::time_point start = StatsClock::now();
+   result.waitMs = std::chrono::duration<double, std::milli>(start - job.queued).count();
+
+   SearchLimits & limits = context.limits;
+   limits.cancel = job.cancel.get();
+   setLimits(limits, request.budget, request.deadlineMs, job.queued);
+   if (job.cancel->load()) {
+      result.status = PlanStatus::kCancelled;
+   } else if (limits.hasDeadline && start >= limits.deadline) {
+      result.status = PlanStatus::kExpired;
+   } else if (!validQueryPos(request.init, grid) || !validQueryPos(request.goal, grid)) {
+      result.status = PlanStatus::kNoPath;
+   } else if (findPath(request.engine, grid, context, request.init, request.goal)) {
+      int goalCell = cellIndex(grid, request.goal[0], request.goal[1]);
+      result.status = PlanStatus::kFound;
+      result.length = context.scratch[goalCell].g;
+      if (request.wantPath) { extractPath(grid, context, goalCell, result.path); }
+      result.expanded = limits.spent;
+   } else {
+      bool cancelled = limits.aborted && job.cancel->load();
+      result.status = cancelled ? PlanStatus::kCancelled
+                                : (limits.aborted ? PlanStatus::kAborted : PlanStatus::kNoPath);
+      result.expanded = limits.spent;
+   }
+   result.searchMs = std::chrono::duration<double, std::milli>(StatsClock::now() - start).count();
+   return result;
+}
+
+// Worker thread of a planning service
+void serviceWorker(PlanningService & service) {
+   SearchContext<> context;
+   PlanJob job;
+   while (popQueue(service.queue, job)) {
+      PlanResult result = answerPlan(*service.grid, context, job);
+      uint64_t wait = static_cast<uint64_t>(result.waitMs * 1000);
+      service.waitMicros += wait;
+      uint64_t longest = service.maxWaitMicros.load();
+      while (wait > longest && !service.maxWaitMicros.compare_exchange_weak(longest, wait)) {}
+      service.outcomes[static_cast<int>(result.status)]++;
+      if (job.done) { job.done(result); }
+      job.promise.set_value(std::move(result));
    }
-   return row;   
 }
 
 /*
- * Reads the file denoted by input path and
- * returns a grid object containing State cells
- */
-auto readGridFile(const string path) {
-   ifstream bFile(path);
-   vector<vector<State>> grid{};
-
-   if (bFile) {
-      string line;
-      vector<State> row;
-      while(getline(bFile, line)) {
-         row = parseLine(line);
-	      if (row.empty()) {
-            cout << "Failed to parse grid file. Invalid content!\n";
-	         grid.clear(); 
-            return grid;
-	      }
-         grid.push_back(row);
-	      row.clear();
-      }
+ * Starts the given number of workers, at least one, answering queries
+ * on the given grid through a queue of the given capacity
+ */
+void startService(PlanningService & service, const Grid & grid, unsigned workers,
+                  size_t capacity = kServiceQueueSize) {
+   service.grid = &grid;
+   service.queue.capacity = std::max<size_t>(1, capacity);
+   for (unsigned i = 0; i < std::max(1u, workers); i++) {
+      service.workers.emplace_back(serviceWorker, std::ref(service));
    }
-   return grid;    
 }
 
 /*
- * Takes State as input and returns corresponding
- * ASCII String
+ * Answers the queries still queued, then stops the workers. Queries
+ * submitted from then on are rejected.
  */
-string cellString(State state) {
-   switch(state) {
-      case State::kObstacle: return  "⛰️   ";
-      case State::kPath: return "🚗  ";
-      case State::kStart: return "🚦  ";
-      case State::kFinish: return "🏁   ";
-      default: return "0   "; 
+void stopService(PlanningService & service) {
+   closeQueue(service.queue);
+   for (auto & worker : service.workers) { worker.join(); }
+   service.workers.clear();
+}
+
+/*
+ * Submits a query to the service and returns its ticket. When the
+ * queue is full the query is rejected right away, unless wait is set,
+ * in which case the call waits for room. done, if given, is called
+ * with the result on the worker thread that answered the query, or
+ * on the calling thread for a rejected query, before the result of
+ * the ticket becomes ready.
+ */
+PlanTicket submitPlan(PlanningService & service, const PlanRequest & request, bool wait = false,
+                      std::function<void(const PlanResult &)> done = nullptr) {
+   PlanJob job;
+   job.request = request;
+   job.cancel = std::make_shared<std::atomic<bool>>(false);
+   job.done = std::move(done);
+   job.queued = StatsClock::now();
+   PlanTicket ticket;
+   ticket.result = job.promise.get_future();
+   ticket.cancel = job.cancel;
+   bool waited = false;
+   ticket.accepted = pushQueue(service.queue, job, wait, waited);
+   if (!ticket.accepted) {
+      PlanResult result;
+      service.outcomes[static_cast<int>(PlanStatus::kRejected)]++;
+      if (job.done) { job.done(result); }
+      job.promise.set_value(std::move(result));
+      return ticket;
    }
+   service.submitted++;
+   if (waited) { service.stalled++; }
+   return ticket;
 }
-    
+
+/*
+ * Asks the service to give up on the query of the given ticket. A
+ * query still in the queue is never run, a running search stops
+ * within kLimitPoll expansions. Its result is kCancelled unless it
+ * was answered first.
+ */
+void cancelPlan(const PlanTicket & ticket) {
+   if (ticket.cancel) { ticket.cancel->store(true); }
+}
+
+ServiceMetrics serviceMetrics(PlanningService & service) {
+   ServiceMetrics metrics;
+   metrics.submitted = service.submitted.load();
+   metrics.stalled = service.stalled.load();
+   uint64_t answered = 0;
+   for (int i = 0; i < kPlanStatusCount; i++) {
+      metrics.outcomes[i] = service.outcomes[i].load();
+      if (i != static_cast<int>(PlanStatus::kRejected)) { answered += metrics.outcomes[i]; }
+   }
+   {
+      std::lock_guard<std::mutex> lock(service.queue.mutex);
+      metrics.depth = service.queue.items.size();
+      metrics.capacity = service.queue.capacity;
+      metrics.peakDepth = service.queue.peak;
+   }
+   if (answered > 0) { metrics.meanWaitMs = service.waitMicros.load() / 1000.0 / answered; }
+   metrics.maxWaitMs = service.maxWaitMicros.load() / 1000.0;
+   return metrics;
+}
+
+/*
+ * Kinds of synthetic maps for the benchmark
+ *   kRandom : every cell is an obstacle with a fixed probability
+ *   kMaze   : perfect maze with corridors of one cell
+ *   kRooms  : square rooms with one door in every wall between them
+ *   kOpen   : open field with scattered small blocks
+ */
+enum class MapKind {
+   kRandom,
+   kMaze,
+   kRooms,
+   kOpen,
+};
+
+const char * const kMapKindNames[4] = {"random", "maze", "rooms", "open"};
+
+// Side of the rooms of MapKind::kRooms, walls included
+const int kRoomSize = 16;
+
 /*
- * Print the grid states in ASCII string format
+ * Generates a square map of the given kind and size. The same
+ * seed always gives the same map.
  */
-void printBoard(const vector<vector<State>> & grid) {
-   for(auto row : grid) {
-      for (auto cell : row) {
-         cout << cellString(cell);
+Grid generateGrid(MapKind kind, int size, uint32_t seed) {
+   std::mt19937 random(seed);
+   Grid grid = makeGrid(size, size);
+   auto setObstacle = [&](int x, int y) { grid.cells[cellIndex(grid, x, y)] = State::kObstacle; };
+   auto setFree = [&](int x, int y) { grid.cells[cellIndex(grid, x, y)] = State::kEmpty; };
+   switch (kind) {
+      case MapKind::kRandom:
+         for (int x = 0; x < size; x++) {
+            for (int y = 0; y < size; y++) { if (random() % 100 < 20) { setObstacle(x, y); } }
+         }
+         break;
+      case MapKind::kMaze: {
+         // Depth first carving between the cells on even positions
+         for (int x = 0; x < size; x++) {
+            for (int y = 0; y < size; y++) { setObstacle(x, y); }
+         }
+         vector<int32_t> stack{cellIndex(grid, 0, 0)};
+         setFree(0, 0);
+         while (!stack.empty()) {
+            int cell = stack.back();
+            int x = cellX(grid, cell); int y = cellY(grid, cell);
+            int options[4]; int count = 0;
+            for (int d=0; d<4; d++) {
+               int nx = x + 2 * direction_delta[d][0]; int ny = y + 2 * direction_delta[d][1];
+               if (validPosOnGrid(nx, ny, grid) &&
+                   grid.cells[cellIndex(grid, nx, ny)] == State::kObstacle) { options[count++] = d; }
+            }
+            if (count == 0) { stack.pop_back(); continue; }
+            int d = options[random() % count];
+            setFree(x + direction_delta[d][0], y + direction_delta[d][1]);
+            setFree(x + 2 * direction_delta[d][0], y + 2 * direction_delta[d][1]);
+            stack.push_back(cellIndex(grid, x + 2 * direction_delta[d][0], y + 2 * direction_delta[d][1]));
+         }
+         break;
       }
-      cout << "\n";
+      case MapKind::kRooms:
+         for (int x = 0; x < size; x++) {
+            for (int y = 0; y < size; y++) {
+               if (x % kRoomSize == kRoomSize - 1 || y % kRoomSize == kRoomSize - 1) { setObstacle(x, y); }
+            }
+         }
+         // One door in the wall below and right of every room
+         for (int x = 0; x < size; x += kRoomSize) {
+            for (int y = 0; y < size; y += kRoomSize) {
+               int wallX = x + kRoomSize - 1; int wallY = y + kRoomSize - 1;
+               int doorX = std::min<int>(x + random() % (kRoomSize - 1), size - 1);
+               int doorY = std::min<int>(y + random() % (kRoomSize - 1), size - 1);
+               if (wallX < size) { setFree(wallX, doorY); }
+               if (wallY < size) { setFree(doorX, wallY); }
+            }
+         }
+         break;
+      case MapKind::kOpen:
+         for (long b = 0; b < long(size) * size / 512; b++) {
+            int x = random() % size; int y = random() % size;
+            int height = 1 + random() % 6; int width = 1 + random() % 6;
+            for (int i = x; i < std::min(x + height, size); i++) {
+               for (int j = y; j < std::min(y + width, size); j++) { setObstacle(i, j); }
+            }
+         }
+         break;
    }
+   return grid;
 }
 
 /*
- * To Compute Heuristic value for each node.
- * In A* algorithm, heuristic value is the manhattan
- * distance between given node and goal node
+ * Helper function that returns the peak resident memory of the
+ * process in MiB
  */
-int heuristic(int x1, int y1, int x2, int y2) {
-   return abs(x2 - x1) + abs(y2 - y1);
+double peakMemoryMiB() {
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_maxrss / 1024.0;   // ru_maxrss is in KiB on Linux
 }
 
 /*
- * Adds the given node to given list of open nodes
- * and updates the state of that node in the grid to kClosed.
+ * Helper function that returns the given percentile of the
+ * sorted latencies
  */
-void addToOpenNodes(vector<int> node, vector<vector<int>> & open,
-                    vector<vector<State>> & grid) {
-   open.push_back(node);
-   int x = node[0]; int y = node[1];
-   grid[x][y] = State::kClosed;
+double percentile(const vector<double> & sorted, double fraction) {
+   if (sorted.empty()) { return 0; }
+   size_t rank = std::ceil(fraction * sorted.size());
+   return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
 }
 
 /*
- * Helper function for sorting the list in 
- * descending order
+ * Runs the given queries one by one through the given engine and
+ * prints one line of results: p50 and p99 latency, and expansions
+ * per second when built with PLANNER_STATS.
  */
-bool compare(const vector<int> node1, const vector<int> node2) {
-   int f1 = node1[2] + node1[3]; // f = g + h
-   int f2 = node2[2] + node2[3];
-   return f1 > f2;
+template <typename OpenList>
+void benchmarkEngine(const char * name, Engine engine, const Grid & grid,
+                     const vector<PathQuery> & queries) {
+   SearchContext<OpenList> context;
+   vector<double> latencies;
+   uint64_t expanded = 0;
+   double totalMs = 0;
+   int found = 0;
+   for (const PathQuery & query : queries) {
+      StatsClock::time_point start = StatsClock::now();
+      found += findPath(engine, grid, context, query.init, query.goal);
+      double ms = std::chrono::duration<double, std::milli>(StatsClock::now() - start).count();
+      latencies.push_back(ms);
+      totalMs += ms;
+      expanded += context.stats.expanded;
+   }
+   std::sort(latencies.begin(), latencies.end());
+   std::printf("  %-14s %6d/%-6zu %10.3f %10.3f", name, found, queries.size(),
+               percentile(latencies, 0.5), percentile(latencies, 0.99));
+   if (kCollectStats && totalMs > 0) {
+      std::printf(" %12.2f\n", expanded / totalMs / 1000.0);
+   } else {
+      std::printf(" %12s\n", "-");
+   }
 }
 
 /*
- * Sort the given vector in descending order
- * using the custom compare function
+ * Benchmark mode. Generates every kind of map at each of the given
+ * sizes, runs the same seeded set of queries between connected free
+ * cells against each engine and reports latencies, expansion rate
+ * and peak memory. The sorted open list is only run on small maps
+ * as its cost grows too fast to finish on the large ones.
  */
-void sortNodes(vector<vector<int>> *v) {
-   sort(v->begin(), v->end(), compare);
+void runBenchmark(const vector<int> & sizes) {
+   const int kSortedMaxSize = 256;
+   const uint32_t kSeed = 2024;
+   std::printf("%-8s %6s %-14s %13s %10s %10s %12s\n", "map", "size", "engine",
+               "found", "p50 ms", "p99 ms", "Mexp/s");
+   for (int size : sizes) {
+      for (int k = 0; k < 4; k++) {
+         MapKind kind = static_cast<MapKind>(k);
+         Grid grid = generateGrid(kind, size, kSeed + k);
+         buildOccupancy(grid);
+         buildComponents(grid);
+         StatsClock::time_point start = StatsClock::now();
+         buildTiles(grid);
+         buildHierarchy(grid);
+         double hierarchyMs =
+            std::chrono::duration<double, std::milli>(StatsClock::now() - start).count();
+         start = StatsClock::now();
+         buildLandmarks(grid);
+         double landmarkMs =
+            std::chrono::duration<double, std::milli>(StatsClock::now() - start).count();
+         start = StatsClock::now();
+         vector<uint32_t> field;
+         distanceField(grid, grid.landmarks.cells.empty() ? 0 : grid.landmarks.cells[0], field);
+         double fieldMs =
+            std::chrono::duration<double, std::milli>(StatsClock::now() - start).count();
+
+         // Fewer queries on larger maps, where each one takes longer
+         int count = std::max(20, 200 * 64 / size);
+         std::mt19937 random(kSeed + size);
+         vector<PathQuery> queries;
+         for (int attempt = 0; queries.size() < size_t(count) && attempt < 100 * count; attempt++) {
+            PathQuery query{};
+            for (int i = 0; i < 2; i++) {
+               query.init[i] = random() % size;
+               query.goal[i] = random() % size;
+            }
+            int init = cellIndex(grid, query.init[0], query.init[1]);
+            int goal = cellIndex(grid, query.goal[0], query.goal[1]);
+            if (validOpenNodePos(init, grid) && validOpenNodePos(goal, grid) &&
+                sameComponent(grid, init, goal)) { queries.push_back(query); }
+         }
+
+         std::printf("%-8s %6d (hierarchy built in %.1f ms, %d landmarks in %.1f ms, %.1f MiB, "
+                     "distance field in %.1f ms)\n",
+                     kMapKindNames[k], size, hierarchyMs, grid.landmarks.count, landmarkMs,
+                     grid.landmarks.distances.size() * sizeof(uint16_t) / 1048576.0, fieldMs);
+         if (size <= kSortedMaxSize) {
+            benchmarkEngine<SortedOpenList>("sorted A*", Engine::kAStar, grid, queries);
+         }
+         benchmarkEngine<BinaryHeapOpenList>("heap A*", Engine::kAStar, grid, queries);
+         benchmarkEngine<BinaryHeapOpenList>("tiled A*", Engine::kTiled, grid, queries);
+         benchmarkEngine<BinaryHeapOpenList>("JPS", Engine::kJumpPoint, grid, queries);
+         benchmarkEngine<BinaryHeapOpenList>("HPA*", Engine::kHierarchical, grid, queries);
+         benchmarkEngine<BinaryHeapOpenList>("bidirectional", Engine::kBidirectional, grid, queries);
+         benchmarkEngine<BinaryHeapOpenList>("ALT", Engine::kLandmark, grid, queries);
+      }
+      std::printf("peak memory after size %d: %.1f MiB\n", size, peakMemoryMiB());
+   }
 }
 
 /*
- * Helper function that checks whether the given 
- * x and y values are valid positions on given grid
+ * Output formats of the batch mode, one line per query
+ *   kLength : cost of the path, -1 if there is none
+ *   kPath   : cost followed by the run-length encoded moves
+ *   kStats  : cost followed by nodes expanded, nodes pushed, peak
+ *             open list size and search time in milliseconds
+ *   kWaypoints : cost followed by the x,y positions of the smoothed
+ *                path of smoothPath
  */
-bool validPosOnGrid(int x, int y, const vector<vector<State>> & grid) {
-   bool x_on_grid = (x >= 0 && x < grid.size());
-   bool y_on_grid = (y >= 0 && y < grid[0].size());
-   return x_on_grid && y_on_grid;
+enum class OutputFormat {
+   kLength,
+   kPath,
+   kStats,
+   kWaypoints,
+};
+
+// Names of the engines in the order of Engine
+const int kEngineCount = 8;
+const char * const kEngineNames[kEngineCount] = {"astar", "jps", "hpa", "bidirectional",
+                                                 "octile", "weighted", "alt", "tiled"};
+
+/*
+ * Helper function that looks up the engine of the given name.
+ * Returns false if there is no such engine.
+ */
+bool parseEngine(const string & name, Engine & engine) {
+   for (int i = 0; i < kEngineCount; i++) {
+      if (name == kEngineNames[i]) {
+         engine = static_cast<Engine>(i);
+         return true;
+      }
+   }
+   return false;
 }
 
 /*
- * Returns true if the given node position is 
- * a) On the grid
- * b) Is empty 
- * else returns false
+ * Helper functions for the layers some engines search besides the
+ * grid: the HPA* hierarchy, the landmark tables and the tiled copy.
+ * engineReady tells whether the layer of the given engine is there,
+ * and prepareEngine builds it when it is not. The other engines need
+ * no layer.
  */
-bool validOpenNodePos(int x, int y, const vector<vector<State>> & grid) {
-   if (validPosOnGrid(x, y, grid)) {
-      return grid[x][y] == State::kEmpty;
-   } else { return false; }
+bool engineReady(const Grid & grid, Engine engine) {
+   switch (engine) {
+      case Engine::kHierarchical: return grid.hierarchy.clusterSize > 0;
+      case Engine::kLandmark: return grid.landmarks.count > 0;
+      case Engine::kTiled: return !grid.tiles.costs.empty();
+      default: return true;
+   }
+}
+
+void prepareEngine(Grid & grid, Engine engine) {
+   if (engineReady(grid, engine)) { return; }
+   switch (engine) {
+      case Engine::kHierarchical: buildHierarchy(grid); break;
+      case Engine::kLandmark: buildLandmarks(grid); break;
+      case Engine::kTiled: buildTiles(grid); break;
+      default: break;
+   }
 }
 
 /*
- * Expand from current node to neighbouring nodes.
- * While iterating through neighbouring nodes,
- * if the node is open i.e. (not closed && empty && on grid)
- * then add that node to open list else skip that node
+ * Check mode. Runs the given number of seeded random queries on
+ * small random maps of 30 to 35% obstacles through every engine that
+ * promises the shortest four-connected path, and compares each cost
+ * with a breadth first search from the start. Also checks the number
+ * of waypoints smoothPath leaves of a path around a block. Prints
+ * every query where an engine disagrees.
+ * Returns the number of disagreements.
  */
-void expandNeighbours(const vector<int> currNode,
-                      const int goal[2],
-                      vector<vector<int>> & open, 
-                      vector<vector<State>> & grid) {
-   // Iterate through potential neighbour node positions
-   for (int i=0; i<4; i++) {  // limit 4 is taken from direction_delta 2D array
-      int x = currNode[0] + direction_delta[i][0];
-      int y = currNode[1] + direction_delta[i][1];
-      if (validOpenNodePos(x, y, grid)) {
-         // Valid open node position. Assign g and h values and add to open list
-         int g = currNode[2] + 1;  // Increment the cost value by 1.
-         int h = heuristic(x, y, goal[0], goal[1]);
-         // Form the node and add it to open list
-         vector<int> node{x, y, g, h};
-         addToOpenNodes(node, open, grid);
+long runCheck(long queryCount) {
+   const uint32_t kSeed = 2024;
+   const int kQueriesPerMap = 100;
+   const Engine kExactEngines[] = {Engine::kAStar, Engine::kJumpPoint, Engine::kBidirectional,
+                                   Engine::kLandmark, Engine::kTiled};
+   std::mt19937 random(kSeed);
+   SearchContext<> context;
+   vector<uint32_t> field;
+   long failures = 0;
+   for (long done = 0; done < queryCount; ) {
+      Grid grid = makeGrid(20 + random() % 21, 20 + random() % 21);
+      int density = 30 + random() % 6;
+      for (int x = 0; x < grid.rows; x++) {
+         for (int y = 0; y < grid.columns; y++) {
+            if (int(random() % 100) < density) { grid.cells[cellIndex(grid, x, y)] = State::kObstacle; }
+         }
+      }
+      buildOccupancy(grid);
+      buildComponents(grid);
+      buildTiles(grid);
+      buildLandmarks(grid);
+      for (int q = 0; q < kQueriesPerMap && done < queryCount; q++, done++) {
+         int init[2] = {int(random() % grid.rows), int(random() % grid.columns)};
+         int goal[2] = {int(random() % grid.rows), int(random() % grid.columns)};
+         if (!validQueryPos(init, grid) || !validQueryPos(goal, grid)) { continue; }
+         int goalCell = cellIndex(grid, goal[0], goal[1]);
+         distanceField(grid, cellIndex(grid, init[0], init[1]), field, 1);
+         int32_t expected = (field[goalCell] == std::numeric_limits<uint32_t>::max())
+                               ? -1 : int32_t(field[goalCell]);
+         for (Engine engine : kExactEngines) {
+            int32_t length = findPath(engine, grid, context, init, goal)
+                                ? context.scratch[goalCell].g : -1;
+            if (length == expected) { continue; }
+            failures++;
+            std::printf("%dx%d map %ld: %d %d %d %d %s gives %d, breadth first search %d\n",
+                        grid.rows, grid.columns, done / kQueriesPerMap, init[0], init[1],
+                        goal[0], goal[1], kEngineNames[static_cast<int>(engine)], length, expected);
+         }
       }
    }
+
+   // A path around a block whose middle corner is hidden from the start
+   // while its last corner is in view again pulls tight to two waypoints
+   Grid grid = makeGrid(5, 5);
+   grid.cells[cellIndex(grid, 2, 2)] = State::kObstacle;
+   buildOccupancy(grid);
+   vector<int32_t> path;
+   vector<int32_t> waypoints;
+   for (int y = 0; y < 4; y++) { path.push_back(cellIndex(grid, 0, y)); }
+   for (int x = 0; x < 4; x++) { path.push_back(cellIndex(grid, x, 4)); }
+   for (int y = 4; y >= 0; y--) { path.push_back(cellIndex(grid, 4, y)); }
+   smoothPath(grid, path, waypoints);
+   if (waypoints.size() != 2) {
+      failures++;
+      std::printf("smoothPath gives %zu waypoints around a block, expected 2\n", waypoints.size());
+   }
+   std::printf("%ld queries checked, %ld disagreements\n", queryCount, failures);
+   return failures;
 }
 
 /*
- * Finds the optimum path between start and finish
- * points in the given grid using A* search algorithm
- * and returns the solved grid.
+ * Batch helper that answers a multi-target query, read from the given
+ * stream past its keyword:
+ *   distances x y x1 y1 x2 y2 ... : cost from x y to every target,
+ *                                   -1 for the ones it cannot reach
+ *   nearest x y x1 y1 x2 y2 ...   : index of the target nearest to
+ *                                   x y and its cost, -1 -1 if none
+ *                                   can be reached
+ * Writes "error" if the positions cannot be parsed or lie off the board.
  */
-vector<vector<State>> searchPath(vector<vector<State>> grid, const int init[2], const int goal[2]) {
+void answerTargetQuery(const Grid & grid, SearchContext<> & context, const string & keyword,
+                       istringstream & stream, std::ostream & output) {
+   int init[2];
+   int target[2];
+   ArenaScope scope;
+   ScratchVector<int32_t> targets;
+   bool valid = static_cast<bool>(stream >> init[0] >> init[1]) &&
+                validPosOnGrid(init[0], init[1], grid);
+   while (valid && stream >> target[0]) {
+      valid = (stream >> target[1]) && validPosOnGrid(target[0], target[1], grid);
+      targets.push_back(cellIndex(grid, target[0], target[1]));
+   }
+   if (!valid || !stream.eof() || targets.empty()) {
+      output << "error\n";
+      return;
+   }
+   bool startFree = validQueryPos(init, grid);
+   if (keyword == "nearest") {
+      int32_t distance = -1;
+      int nearest = startFree ? findNearest(grid, context, init, targets, distance) : -1;
+      output << nearest << ' ' << distance << '\n';
+      return;
+   }
+   ScratchVector<int32_t> distances(targets.size(), -1);
+   if (startFree) { findDistances(grid, context, init, targets, distances); }
+   for (size_t i = 0; i < distances.size(); i++) {
+      output << (i ? " " : "") << distances[i];
+   }
+   output << '\n';
+}
 
-   /*
-    * For A* Search algorithm,
-    * There should be a list of open nodes which it will check 
-    * every iteration. Each node should contain following information
-    *   x and y position values 
-    *   g value (Represents the cost/steps it took to reach that node from starting node)
-    *   h value (Represents the Manhattan distance between this node and finishing node)
-    * As you get closer to goal, h value decreases and g value increases.
-    * 
-    * A* search algorithm picks the node that has the least g+h value from the list of open
-    * nodes and expand from it to neighbouring nodes.
-    * The neighbouring nodes that are not yet closed(already processed), are on grid and are
-    * empty will get added to open nodes list. Once a node is added to open nodes list, it's
-    * state should be closed.
-    * Keep picking the node with lowest f value(g+h) from the open nodes list and process it 
-    * as described above until the path to goal node is found or until there are no more nodes
-    * present in the open list.
-    */
+/*
+ * Batch mode. Answers the queries read line by line from input,
+ * each written as "x1 y1 x2 y2" optionally followed by an engine
+ * name that overrides the given default engine, or a multi-target
+ * query answered by answerTargetQuery. Blank lines and
+ * lines starting with # are skipped. Every query gets one line of
+ * output in the given format, or "error" if it cannot be parsed.
+ * With flush set each answer is flushed as soon as it is written,
+ * for callers that stream queries through a pipe. Queries go through
+ * the given path cache unless it is null. Every path search gives up
+ * after budget expansions or deadlineMs milliseconds, 0 for no limit,
+ * and then writes "aborted". The layer of an engine that a line asks
+ * for is built by prepareEngine the first time it is needed.
+ * Returns the number of queries answered.
+ */
+size_t runBatch(Grid & grid, std::istream & input, std::ostream & output,
+                Engine engine, OutputFormat format, bool flush, PathCache * cache,
+                uint64_t budget = 0, double deadlineMs = 0) {
+   SearchContext<> context;
+   vector<int32_t> path;
+   vector<int32_t> waypoints;
+   string line;
+   size_t answered = 0;
+   while (getline(input, line)) {
+      size_t first = line.find_first_not_of(" \t\r");
+      if (first == string::npos || line[first] == '#') { continue; }
+      istringstream stream(line);
+      int init[2]; int goal[2];
+      string name;
+      Engine queryEngine = engine;
+      string keyword = line.substr(first, line.find_first_of(" \t\r", first) - first);
+      if (keyword == "distances" || keyword == "nearest") {
+         stream >> keyword;
+         answerTargetQuery(grid, context, keyword, stream, output);
+      } else if (!(stream >> init[0] >> init[1] >> goal[0] >> goal[1]) ||
+          ((stream >> name) && !parseEngine(name, queryEngine))) {
+         output << "error\n";
+      } else {
+         bool valid = validQueryPos(init, grid) && validQueryPos(goal, grid);
+         int goalCell = cellIndex(grid, goal[0], goal[1]);
+         int32_t length = -1;
+         bool found = false;
+         if (valid) { prepareEngine(grid, queryEngine); }
+         setLimits(context.limits, budget, deadlineMs, StatsClock::now());
+         if (valid && cache != nullptr) {
+            found = cachedFindPath(*cache, queryEngine, grid, context, init, goal, path, length);
+         } else if (valid && findPath(queryEngine, grid, context, init, goal)) {
+            found = true;
+            length = context.scratch[goalCell].g;
+            if (format == OutputFormat::kPath || format == OutputFormat::kWaypoints) {
+               extractPath(grid, context, goalCell, path);
+            }
+         }
+         if (!found && context.limits.aborted) {
+            output << "aborted";
+         } else {
+            output << length;
+         }
+         if (format == OutputFormat::kPath && found) {
+            output << ' ' << encodeMoves(grid, path);
+         } else if (format == OutputFormat::kWaypoints && found) {
+            smoothPath(grid, path, waypoints);
+            for (int32_t cell : waypoints) {
+               output << ' ' << cellX(grid, cell) << ',' << cellY(grid, cell);
+            }
+         } else if (format == OutputFormat::kStats) {
+            SearchStats stats = valid ? context.stats : SearchStats{};
+            output << ' ' << stats.expanded << ' ' << stats.pushed << ' ' << stats.peakOpen
+                   << ' ' << stats.searchMs;
+         }
+         output << '\n';
+      }
+      if (flush) { output.flush(); }
+      answered++;
+   }
+   return answered;
+}
 
-   /*
-    * Form the starting node to be added to list of open node
-    */
-   int x = init[0]; int y = init[1];  // Position information
-   int g = 0; // Cost
-   int h = heuristic(x, y, goal[0], goal[1]);  // Calculates Manhattan distance to goal node
-   vector<int> startNode{x, y, g, h}; 
+/*
+ * Multithreaded version of runBatch for the length and stats formats.
+ * Reads all of input first, then answers its path queries at once with
+ * searchBatch on the given number of threads (0 for one per hardware
+ * thread). Multi-target lines are answered afterwards on the calling
+ * thread. The output is the same as that of runBatch, in input order.
+ * Returns the number of queries answered.
+ */
+size_t runParallelBatch(Grid & grid, std::istream & input, std::ostream & output,
+                        Engine engine, OutputFormat format, unsigned threads) {
+   const int kErrorLine = -1;
+   const int kTargetLine = -2;
+   vector<string> lines;
+   vector<int> slots;  // Index into queries of every line, or kErrorLine or kTargetLine
+   vector<PathQuery> queries;
+   string line;
+   while (getline(input, line)) {
+      size_t first = line.find_first_not_of(" \t\r");
+      if (first == string::npos || line[first] == '#') { continue; }
+      istringstream stream(line);
+      PathQuery query{};
+      query.engine = engine;
+      string name;
+      string keyword = line.substr(first, line.find_first_of(" \t\r", first) - first);
+      if (keyword == "distances" || keyword == "nearest") {
+         slots.push_back(kTargetLine);
+      } else if (!(stream >> query.init[0] >> query.init[1] >> query.goal[0] >> query.goal[1]) ||
+                 ((stream >> name) && !parseEngine(name, query.engine))) {
+         slots.push_back(kErrorLine);
+      } else {
+         if (validQueryPos(query.init, grid) && validQueryPos(query.goal, grid)) {
+            prepareEngine(grid, query.engine);
+         }
+         slots.push_back(queries.size());
+         queries.push_back(query);
+      }
+      lines.push_back(std::move(line));
+   }
 
-   /*
-    * Add the node to list of open nodes
-    */
-   vector<vector<int>> openNodes{};  // Empty list of open nodes
-   addToOpenNodes(startNode, openNodes, grid);  // Add the starting node to list of open nodes
+   vector<PathResult> results(queries.size());
+   searchBatch(grid, queries.data(), queries.size(), results.data(), threads);
 
-   /*
-    * Keep processing the list of open nodes until the list is empty
-    * or until the goal node is reached
-    */
-   while(!openNodes.empty()) {
-      /*
-       * To fetch the node with the least (g+h) value from the open nodes list,
-       * sort the list in descending order and pick the last node as the current
-       * node to expand to neighbours
-       */
-      sortNodes(&openNodes); // Sorts the list in descending order
-      
-      // Fetch the node with least g+h value
-      vector<int> currNode = openNodes.back();
-      openNodes.pop_back();
-      
-      // Extract position data
-      int x = currNode[0]; int y = currNode[1];
+   SearchContext<> context;
+   for (size_t i = 0; i < lines.size(); i++) {
+      if (slots[i] == kTargetLine) {
+         istringstream stream(lines[i]);
+         string keyword;
+         stream >> keyword;
+         answerTargetQuery(grid, context, keyword, stream, output);
+      } else if (slots[i] == kErrorLine) {
+         output << "error\n";
+      } else {
+         const PathResult & result = results[slots[i]];
+         output << result.length;
+         if (format == OutputFormat::kStats) {
+            output << ' ' << result.stats.expanded << ' ' << result.stats.pushed << ' '
+                   << result.stats.peakOpen << ' ' << result.stats.searchMs;
+         }
+         output << '\n';
+      }
+   }
+   return lines.size();
+}
 
-      // Check if current node is the goal node
-      if (x == goal[0] && y == goal[1]) {
-         // Reached goal. Mark start and end State in grid
-         int startX = init[0]; int startY = init[1];
-         grid[startX][startY] = State::kStart;
-         grid[x][y] = State::kFinish;
-         return grid;
+/*
+ * Fleet version of runBatch. Reads every "x1 y1 x2 y2" line of input
+ * as one agent, plans them all with planFleet in the order they are
+ * given and writes one line per agent: the timestep at which it
+ * arrives (-1 if no plan was found), followed by its moves in the
+ * path format, or "error" if the line cannot be parsed.
+ * Returns the number of agents read.
+ */
+size_t runFleet(const Grid & grid, std::istream & input, std::ostream & output,
+                OutputFormat format) {
+   vector<PathQuery> agents;
+   vector<bool> parsed;
+   string line;
+   while (getline(input, line)) {
+      size_t first = line.find_first_not_of(" \t\r");
+      if (first == string::npos || line[first] == '#') { continue; }
+      istringstream stream(line);
+      PathQuery agent{};
+      string rest;
+      parsed.push_back((stream >> agent.init[0] >> agent.init[1] >> agent.goal[0] >> agent.goal[1]) &&
+                       !(stream >> rest));
+      if (!parsed.back()) { agent = PathQuery{{-1, -1}, {-1, -1}, Engine::kAStar}; }
+      agents.push_back(agent);
+   }
+   SpaceTimeContext context;
+   vector<vector<int32_t>> paths;
+   planFleet(grid, context, agents, paths);
+   for (size_t i = 0; i < agents.size(); i++) {
+      if (!parsed[i]) {
+         output << "error\n";
+         continue;
       }
+      output << int(paths[i].size()) - 1;
+      if (format == OutputFormat::kPath && !paths[i].empty()) {
+         output << ' ' << encodeMoves(grid, paths[i]);
+      }
+      output << '\n';
+   }
+   return agents.size();
+}
 
-      // Not goal node. Update grid State for the current node
-      grid[x][y] = State::kPath;
+/*
+ * Service version of runBatch. Submits every "x1 y1 x2 y2 [engine]"
+ * line of input to a planning service of the given number of workers
+ * and queue capacity, with the budget and deadline of the given
+ * request, and writes one line per query in input order: the cost or
+ * -1 like runBatch, or the status of a query that was aborted or
+ * expired. kStats writes the cost, nodes expanded, queue wait and
+ * search time in milliseconds. When the queue is full the oldest
+ * answer is written out before trying again, so that reading never
+ * runs far ahead of the workers. Prints the backpressure metrics of
+ * the service to stderr at the end. Before a line whose engine still
+ * needs its layer is submitted, all answers are written out, so that no
+ * worker reads the grid while prepareEngine builds the layer.
+ * Returns the number of lines answered.
+ */
+size_t runService(Grid & grid, std::istream & input, std::ostream & output,
+                  const PlanRequest & defaults, OutputFormat format, bool flush,
+                  unsigned workers, size_t capacity) {
+   PlanningService service;
+   startService(service, grid, workers, capacity);
+   std::deque<PlanTicket> pending;  // Tickets without a result are lines that did not parse
+   vector<int32_t> waypoints;
+   size_t answered = 0;
+   auto writeFront = [&]() {
+      PlanTicket & ticket = pending.front();
+      if (!ticket.result.valid()) {
+         output << "error\n";
+      } else {
+         PlanResult result = ticket.result.get();
+         if (result.status == PlanStatus::kFound || result.status == PlanStatus::kNoPath) {
+            output << result.length;
+         } else {
+            output << kPlanStatusNames[static_cast<int>(result.status)];
+         }
+         if (format == OutputFormat::kPath && result.status == PlanStatus::kFound) {
+            output << ' ' << encodeMoves(grid, result.path);
+         } else if (format == OutputFormat::kWaypoints && result.status == PlanStatus::kFound) {
+            smoothPath(grid, result.path, waypoints);
+            for (int32_t cell : waypoints) {
+               output << ' ' << cellX(grid, cell) << ',' << cellY(grid, cell);
+            }
+         } else if (format == OutputFormat::kStats) {
+            output << ' ' << result.expanded << ' ' << result.waitMs << ' ' << result.searchMs;
+         }
+         output << '\n';
+      }
+      if (flush) { output.flush(); }
+      pending.pop_front();
+      answered++;
+   };
 
-      // Expand neighbours and add valid nodes to open nodes list
-      expandNeighbours(currNode, goal, openNodes, grid);
+   string line;
+   while (getline(input, line)) {
+      size_t first = line.find_first_not_of(" \t\r");
+      if (first == string::npos || line[first] == '#') { continue; }
+      istringstream stream(line);
+      PlanRequest request = defaults;
+      request.wantPath = (format == OutputFormat::kPath || format == OutputFormat::kWaypoints);
+      string name;
+      if (!(stream >> request.init[0] >> request.init[1] >> request.goal[0] >> request.goal[1]) ||
+          ((stream >> name) && !parseEngine(name, request.engine))) {
+         pending.emplace_back();
+      } else {
+         if (!engineReady(grid, request.engine)) {
+            while (!pending.empty()) { writeFront(); }
+            prepareEngine(grid, request.engine);
+         }
+         for (;;) {
+            PlanTicket ticket = submitPlan(service, request, pending.empty());
+            if (ticket.accepted) {
+               pending.push_back(std::move(ticket));
+               break;
+            }
+            writeFront();
+         }
+      }
+      // Write out the answers that are ready without waiting for the others
+      while (!pending.empty() && (!pending.front().result.valid() ||
+                                  pending.front().result.wait_for(std::chrono::seconds(0)) ==
+                                     std::future_status::ready)) { writeFront(); }
+   }
+   while (!pending.empty()) { writeFront(); }
+   stopService(service);
+
+   ServiceMetrics metrics = serviceMetrics(service);
+   auto outcome = [&](PlanStatus status) { return metrics.outcomes[static_cast<int>(status)]; };
+   std::cerr << "Answered " << answered << " queries on " << std::max(1u, workers) << " workers: "
+             << outcome(PlanStatus::kFound) << " found, " << outcome(PlanStatus::kNoPath)
+             << " without path, " << outcome(PlanStatus::kAborted) << " aborted, "
+             << outcome(PlanStatus::kExpired) << " expired; " << outcome(PlanStatus::kRejected)
+             << " submits rejected by a full queue, " << metrics.stalled << " waited, peak depth "
+             << metrics.peakDepth << "/" << metrics.capacity << ", queue wait mean "
+             << metrics.meanWaitMs << " ms, max " << metrics.maxWaitMs << " ms\n";
+   return answered;
+}
+
+/*
+ * Headless mode: route_planner --batch <grid file> [query file]
+ *                [--engine name] [--format length|path|stats|waypoints]
+ *                [--output file] [--cache entries] [--fleet]
+ *                [--workers count] [--queue size] [--budget expansions]
+ *                [--deadline ms] [--threads count]
+ * Loads the grid once and runs runBatch on the query file, or on
+ * stdin when the query file is missing or "-". Results go to stdout
+ * unless an output file is given; messages go to stderr. A stored
+ * HPA* abstraction next to the grid file (<grid file>.hpa) and
+ * stored landmark tables (<grid file>.alt) are used when present,
+ * otherwise they are built once the first query asks for their engine.
+ * With --cache the queries go through a path cache of
+ * that many entries, whose hit rate is reported at the end. With
+ * --fleet the queries are the agents of a fleet planned by runFleet.
+ * With --workers the queries go through a planning service of that
+ * many workers, see runService. With --threads all queries are read
+ * first and answered in parallel by runParallelBatch.
+ * Returns the exit code of the program.
+ */
+int batchMode(int argc, char * argv[]) {
+   string gridPath = argv[2];
+   string queryPath = "-";
+   string outputPath;
+   long cacheEntries = 0;
+   bool fleet = false;
+   long workers = 0;
+   long queueSize = 0;  // kServiceQueueSize unless given
+   long threads = -1;   // runBatch unless given
+   PlanRequest defaults{};
+   Engine engine = Engine::kAStar;
+   OutputFormat format = OutputFormat::kLength;
+   for (int i = 3; i < argc; i++) {
+      string arg = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (arg == "--engine" && hasValue) {
+         if (!parseEngine(argv[++i], engine)) {
+            std::cerr << "Unknown engine " << argv[i] << "\n";
+            return 1;
+         }
+      } else if (arg == "--format" && hasValue) {
+         string name = argv[++i];
+         if (name == "length") { format = OutputFormat::kLength; }
+         else if (name == "path") { format = OutputFormat::kPath; }
+         else if (name == "stats") { format = OutputFormat::kStats; }
+         else if (name == "waypoints") { format = OutputFormat::kWaypoints; }
+         else {
+            std::cerr << "Unknown format " << name << "\n";
+            return 1;
+         }
+      } else if (arg == "--output" && hasValue) {
+         outputPath = argv[++i];
+      } else if (arg == "--cache" && hasValue) {
+         cacheEntries = std::max(0L, std::atol(argv[++i]));
+      } else if (arg == "--fleet") {
+         fleet = true;
+      } else if (arg == "--workers" && hasValue) {
+         workers = std::max(1L, std::atol(argv[++i]));
+      } else if (arg == "--threads" && hasValue) {
+         threads = std::max(0L, std::atol(argv[++i]));
+      } else if (arg == "--queue" && hasValue) {
+         queueSize = std::max(1L, std::atol(argv[++i]));
+      } else if (arg == "--budget" && hasValue) {
+         defaults.budget = std::max(0L, std::atol(argv[++i]));
+      } else if (arg == "--deadline" && hasValue) {
+         defaults.deadlineMs = std::max(0.0, std::atof(argv[++i]));
+      } else if (i == 3 && arg.compare(0, 2, "--") != 0) {
+         queryPath = arg;
+      } else {
+         std::cerr << "Unknown argument " << arg << "\n";
+         return 1;
+      }
+   }
+
+   Grid grid = loadGrid(gridPath);
+   if (grid.cells.empty()) {
+      std::cerr << "Invalid file path or grid file " << gridPath << "\n";
+      return 1;
+   }
+   buildOccupancy(grid);
+   buildComponents(grid);
+   readHierarchy(grid, gridPath + ".hpa");
+   mapLandmarks(grid, gridPath + ".alt");
+   prepareEngine(grid, engine);
+   if (format == OutputFormat::kStats && !kCollectStats && workers == 0) {
+      std::cerr << "Search statistics need a build with -DPLANNER_STATS=1\n";
+   }
+   if (queueSize > 0 && workers == 0) {
+      std::cerr << "--queue only applies together with --workers\n";
+   }
+   if (fleet && (defaults.budget > 0 || defaults.deadlineMs > 0)) {
+      std::cerr << "--budget and --deadline do not apply to --fleet\n";
+   }
+
+   if (threads >= 0 && (fleet || workers > 0 || cacheEntries > 0 || defaults.budget > 0 ||
+                        defaults.deadlineMs > 0)) {
+      std::cerr << "--threads cannot be combined with --fleet, --workers, --cache, "
+                   "--budget or --deadline\n";
+      return 1;
+   }
+   if (threads >= 0 && format != OutputFormat::kLength && format != OutputFormat::kStats) {
+      std::cerr << "--threads only supports the length and stats formats\n";
+      return 1;
+   }
+
+   std::ifstream queryFile;
+   if (queryPath != "-") {
+      queryFile.open(queryPath);
+      if (!queryFile) {
+         std::cerr << "Cannot open query file " << queryPath << "\n";
+         return 1;
+      }
+   }
+   std::ofstream outputFile;
+   if (!outputPath.empty()) {
+      outputFile.open(outputPath, std::ios::trunc);
+      if (!outputFile) {
+         std::cerr << "Cannot write output file " << outputPath << "\n";
+         return 1;
+      }
+   }
+   std::istream & input = queryFile.is_open() ? static_cast<std::istream &>(queryFile) : std::cin;
+   std::ostream & output = outputFile.is_open() ? static_cast<std::ostream &>(outputFile) : cout;
+   if (fleet) {
+      runFleet(grid, input, output, format);
+      return output.flush() ? 0 : 1;
+   }
+   if (workers > 0) {
+      defaults.engine = engine;
+      runService(grid, input, output, defaults, format, !queryFile.is_open(), workers,
+                 queueSize > 0 ? queueSize : kServiceQueueSize);
+      return output.flush() ? 0 : 1;
+   }
+   if (threads >= 0) {
+      runParallelBatch(grid, input, output, engine, format, threads);
+      return output.flush() ? 0 : 1;
+   }
+   PathCache cache;
+   if (cacheEntries > 0) { initPathCache(cache, cacheEntries); }
+   size_t answered = runBatch(grid, input, output, engine, format, !queryFile.is_open(),
+                              cacheEntries > 0 ? &cache : nullptr, defaults.budget,
+                              defaults.deadlineMs);
+   if (cacheEntries > 0) {
+      PathCacheStats stats = pathCacheStats(cache);
+      uint64_t lookups = stats.hits + stats.reverseHits + stats.misses;
+      std::cerr << "Answered " << answered << " queries, cache hit rate "
+                << (lookups ? 100.0 * (stats.hits + stats.reverseHits) / lookups : 0.0) << "% ("
+                << stats.hits << " hits, " << stats.reverseHits << " reverse hits, "
+                << stats.misses << " misses, " << stats.evictions << " evictions)\n";
    }
+   return output.flush() ? 0 : 1;
+}
 
-   // No path to goal was found. Return an empty grid
-   vector<vector<State>> solution{};
-   return solution;
+/*
+ * Prints the given search statistics onto Terminal
+ */
+void printStats(const SearchStats & stats) {
+   cout << "Search statistics\n"
+        << "  nodes expanded : " << stats.expanded << "\n"
+        << "  nodes pushed   : " << stats.pushed << "\n"
+        << "  peak open list : " << stats.peakOpen << "\n"
+        << "  path length    : " << stats.pathLength << "\n"
+        << "  load time      : " << stats.loadMs << " ms\n"
+        << "  search time    : " << stats.searchMs << " ms\n"
+        << "  output time    : " << stats.outputMs << " ms\n";
 }
 
-void getUserInput(int init[], int goal[], vector<vector<State>> & grid) {
+/*
+ * Reads a valid starting and finishing cell from stdin.
+ * Returns false if stdin ends before both are read.
+ */
+bool getUserInput(int init[], int goal[], Grid & grid) {
    int x=0; int y=0; 
    string line; 
    bool bReadInput = false;
@@ -314,16 +5729,16 @@ void getUserInput(int init[], int goal[], vector<vector<State>> & grid) {
    cout << "======================================================================================\n";
    while(!bReadInput) {
       cout << "Enter starting cell row and column values in grid separated by a space\n";
-      getline(std::cin, line);
+      if (!getline(std::cin, line)) { return false; }
       istringstream stream(line);
       if (stream) {
          stream >> x >> y; 
          if (validPosOnGrid(x, y, grid)) {
-            if (grid[x][y] == State::kEmpty) { 
+            if (grid.cells[cellIndex(grid, x, y)] == State::kEmpty) { 
                bReadInput = true; 
                init[0] = x;
                init[1] = y;
-               grid[x][y] = State::kChosen; 
+               grid.cells[cellIndex(grid, x, y)] = State::kChosen; 
             }
          }
       }
@@ -332,12 +5747,12 @@ void getUserInput(int init[], int goal[], vector<vector<State>> & grid) {
       } else {
          bReadInput = false;
          cout << "Enter finishing cell row and column values in grid separated by a space\n";
-         getline(std::cin, line);
+         if (!getline(std::cin, line)) { return false; }
          istringstream stream(line);
          if (stream) {
             stream >> x >> y;
             if (validPosOnGrid(x, y, grid)) {
-               if (grid[x][y] == State::kEmpty) { 
+               if (grid.cells[cellIndex(grid, x, y)] == State::kEmpty) { 
                   bReadInput = true; 
                   goal[0] = x;
                   goal[1] = y;
@@ -348,19 +5763,106 @@ void getUserInput(int init[], int goal[], vector<vector<State>> & grid) {
             cout << "Invalid Input!!\n";
             // Reset the state of chosen cell back to kEmpty
             int chosenX = init[0]; int chosenY = init[1];
-            grid[chosenX][chosenY] = State::kEmpty;
+            grid.cells[cellIndex(grid, chosenX, chosenY)] = State::kEmpty;
          }
       }
    }
+   return true;
 }
 
-int main() {
+int main(int argc, char * argv[]) {
+   // Converter mode: route_planner --convert <input .grid> <output .gridb>
+   if (argc == 4 && string(argv[1]) == "--convert") {
+      if (!convertGridFile(argv[2], argv[3])) {
+         cout << "Failed to convert " << argv[2] << "\n";
+         return 1;
+      }
+      cout << "Converted " << argv[2] << " into " << argv[3] << "\n";
+      return 0;
+   }
+
+   // Batch mode: route_planner --batch <grid file> [query file] [options]
+   if (argc >= 3 && string(argv[1]) == "--batch") { return batchMode(argc, argv); }
+
+   // Benchmark mode: route_planner --benchmark [map size ...]
+   if (argc >= 2 && string(argv[1]) == "--benchmark") {
+      vector<int> sizes;
+      for (int i = 2; i < argc; i++) {
+         int size = std::atoi(argv[i]);
+         if (size < 64 || size > 16384) {
+            cout << "Map sizes must be between 64 and 16384\n";
+            return 1;
+         }
+         sizes.push_back(size);
+      }
+      if (sizes.empty()) { sizes = {64, 256, 1024}; }
+      runBenchmark(sizes);
+      return 0;
+   }
+
+   // Check mode: route_planner --check [query count]
+   if ((argc == 2 || argc == 3) && string(argv[1]) == "--check") {
+      long count = (argc == 3) ? std::max(1L, std::atol(argv[2])) : 10000;
+      return runCheck(count) == 0 ? 0 : 1;
+   }
+
+   // Hierarchy mode: route_planner --hierarchy <grid file>
+   // Precomputes the HPA* abstraction and stores it as <grid file>.hpa
+   if (argc == 3 && string(argv[1]) == "--hierarchy") {
+      Grid grid = loadGrid(argv[2]);
+      if (grid.cells.empty()) {
+         cout << "Invalid file path or grid file. Terminating program!\n";
+         return 1;
+      }
+      buildHierarchy(grid);
+      string output = string(argv[2]) + ".hpa";
+      if (!writeHierarchy(grid, output)) {
+         cout << "Failed to write " << output << "\n";
+         return 1;
+      }
+      cout << "Stored " << grid.hierarchy.nodeCells.size() << " entrance nodes in " << output << "\n";
+      return 0;
+   }
+
+   // Landmark mode: route_planner --landmarks <grid file> [count]
+   // Precomputes the ALT distance tables and stores them as <grid file>.alt
+   if ((argc == 3 || argc == 4) && string(argv[1]) == "--landmarks") {
+      Grid grid = loadGrid(argv[2]);
+      if (grid.cells.empty()) {
+         cout << "Invalid file path or grid file. Terminating program!\n";
+         return 1;
+      }
+      int count = (argc == 4) ? std::atoi(argv[3]) : kLandmarkCount;
+      if (count < 1 || count > kMaxLandmarks) {
+         cout << "Landmark count must be between 1 and " << kMaxLandmarks << "\n";
+         return 1;
+      }
+      // The tables hold two bytes per landmark for every cell of the grid buffer
+      cout << "Building " << count << " landmarks, "
+           << grid.cells.size() * count * sizeof(uint16_t) / 1048576.0 << " MiB of tables\n";
+      buildLandmarks(grid, count);
+      string output = string(argv[2]) + ".alt";
+      if (!writeLandmarks(grid, output)) {
+         cout << "Failed to write " << output << "\n";
+         return 1;
+      }
+      cout << "Stored " << grid.landmarks.count << " landmarks in " << output << "\n";
+      return 0;
+   }
+
+   // Interactive mode: route_planner [--crop <margin>]
+   // With --crop only the area around the path is printed with the solution
+   int crop = -1;
+   if (argc == 3 && string(argv[1]) == "--crop") {
+      crop = std::max(0, std::atoi(argv[2]));
+   }
+
    cout << "Using A* search algorithm, this program will find the optimum path\n";
    cout << "between any 2 user given points in a 2 Dimensional Grid comprising\n";
    cout << "of randomly placed obstacles.\n\n";
 
    // Declare an empty grid
-   vector<vector<State>> grid{}; 
+   Grid grid{}; 
 
    cout << "Choose a grid file from the grid_files folder and enter its name below\n";
    string path("grid_files/");
@@ -368,36 +5870,62 @@ int main() {
    getline(std::cin, filename);
 
    // Read state data from file and populate grid
-   grid = readGridFile(path+filename); 
+   StatsClock::time_point loadStart = statsTime();
+   grid = loadGrid(path+filename); 
 
-   if (grid.empty()) { 
+   if (grid.cells.empty()) { 
       cout << "Invalid file path or grid file. Terminating program!\n";  
       return 0;
    }  
 
+   // Build the bit-packed occupancy layer used by the jump point search
+   buildOccupancy(grid);
+   // Label the components so that unreachable goals are rejected at once
+   buildComponents(grid);
+   double loadMs = statsElapsed(loadStart);
+
    cout << "Valid grid board! Printing the grid\n";
    printBoard(grid);
 
    // Get the starting and finishing position
    int startPosition[2]{};
    int finishPosition[2]{};
-   getUserInput(startPosition, finishPosition, grid);
+   if (!getUserInput(startPosition, finishPosition, grid)) { return 0; }
    cout << "\n";
 
    /*
     * Search for the optimum path between start to finish
-    * using A* Search Algorithm and return the solution
-    * grid board
+    * using A* Search Algorithm and build the solution
+    * grid board from the path it found
     */
-   auto solutionGrid = searchPath(grid, startPosition, finishPosition);
+   SearchContext<> context;
+   bool found = findPath(Engine::kAStar, grid, context, startPosition, finishPosition);
+   StatsClock::time_point outputStart = statsTime();
 
-   if (solutionGrid.empty()) {
+   if (!found) {
       cout << "No path found\n";
    } else {
-      cout << "Optimum path found. Printing solution grid\n\n";
-      // Print the solved grid board
-      printBoard(solutionGrid); 
+      // Follow the parent links back from the goal to get the path
+      int goalCell = cellIndex(grid, finishPosition[0], finishPosition[1]);
+      vector<int32_t> path;
+      extractPath(grid, context, goalCell, path);
+      cout << "Optimum path found (" << path.size() - 1 << " steps";
+      if (!grid.costs.empty()) { cout << ", cost " << context.scratch[goalCell].g; }
+      cout << ": " << encodeMoves(grid, path) << ")\n";
+      vector<int32_t> waypoints;
+      smoothPath(grid, path, waypoints);
+      cout << "Smoothed to " << waypoints.size() << " waypoints:";
+      for (int32_t cell : waypoints) { cout << " (" << cellX(grid, cell) << "," << cellY(grid, cell) << ")"; }
+      cout << ". Printing solution grid\n\n";
+      // Print the solved grid board, cropped around the path if asked for
+      Viewport view = (crop < 0) ? boardViewport(grid) : pathViewport(grid, path, crop);
+      printBoard(grid, view, path);
    }
 
+   if constexpr (kCollectStats) {
+      context.stats.loadMs = loadMs;
+      context.stats.outputMs = statsElapsed(outputStart);
+      printStats(context.stats);
+   }
    return 0;
 }